@@ -32,6 +32,7 @@ export SCOREP_FILTERING_FILE=GoL-scorep.filt
 # Level 1 and 2 data cache misses, doesnt work, papi not installed
 export SCOREP_METRIC_PAPI=PAPI_L1_DCM,PAPI_L2_DCM
 #,PAPI_L3_DCM
+# without PAPI the program counts the misses itself with --counters=true
 
 
 # mpiexec -np 1 time ./main 1000 10 -1
@@ -50,4 +51,5 @@ export SCOREP_METRIC_PAPI=PAPI_L1_DCM,PAPI_L2_DCM
 
 
 mpirun -np 11 ./bin/GameOfLife 10000 100 10 false false false
+# many small jobs without restarting: --serve=$TMPDIR/gol.sock in the background, then ./server_client.py $TMPDIR/gol.sock --jobs=100 --quit
 # scalasca -analyze -s mpiexec -np 11 ./bin/GameOfLife
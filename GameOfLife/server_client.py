@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+# Sends jobs to a GameOfLife server started with --serve=<socket> and measures its throughput.
+#
+#   mpirun -np 5 ./bin/GameOfLife 1000 100 0 false false false --serve=/tmp/gol.sock &
+#   ./server_client.py /tmp/gol.sock --jobs=50 --job="size=1000 generations=100"
+#   ./server_client.py /tmp/gol.sock --file=jobs.txt --quit
+#
+# Every job line is answered with one line, the seed of the jobs differs unless the job sets it.
+
+import argparse
+import socket
+import sys
+import time
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Send jobs to a GameOfLife server and report jobs per minute")
+    parser.add_argument("socket", help="path of the unix socket of the server")
+    parser.add_argument("--job", default="size=1000 generations=100", help="the job that is sent --jobs times")
+    parser.add_argument("--jobs", type=int, default=10, help="how often the job is sent")
+    parser.add_argument("--file", help="send the lines of this file instead, one job per line")
+    parser.add_argument("--quit", action="store_true", help="stop the server and its workers afterwards")
+    args = parser.parse_args()
+
+    if args.file:
+        with open(args.file) as file:
+            jobs = [line.strip() for line in file if line.strip() and not line.startswith("#")]
+    else:
+        jobs = [args.job] * args.jobs
+
+    client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    client.connect(args.socket)
+    reader = client.makefile("r")
+    failed = 0
+    start = time.perf_counter()
+    for job in jobs:
+        # one job at a time, the time includes the answer of the server
+        client.sendall((job + "\n").encode())
+        reply = reader.readline()
+        if not reply:
+            sys.exit("the server closed the connection")
+        print(reply, end="")
+        if " error " in reply:
+            failed += 1
+    elapsed = time.perf_counter() - start
+    if args.quit:
+        client.sendall(b"quit\n")
+        reader.readline()
+    client.close()
+
+    done = len(jobs) - failed
+    print(f"{done} jobs in {elapsed:.3f} seconds, {done / elapsed * 60 if elapsed > 0 else 0:.1f} jobs per minute, {failed} failed")
+
+
+if __name__ == "__main__":
+    main()
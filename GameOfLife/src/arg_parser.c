@@ -8,10 +8,51 @@
 #include <errno.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <time.h> // time
 
 
+#include "dataflow.h"
+#include "halo_exchange.h"
+#include "kernel_registry.h"
+#include "life3d.h"
+#include "memory_placement.h"
+#include "pattern_loader.h"
+#include "server.h"
+#include "sparse_universe.h"
+
 void quitWithHelpMessage(char* name) {
-    printf("Usage: %s <grid_size:int> <total_iterations:int> <output_steps:int> <console_output:bool> <output_images:bool> <measure_time:bool>\n", name);
+    printf("Usage: %s <grid_size:int> <total_iterations:int> <output_steps:int> <console_output:bool> <output_images:bool> <measure_time:bool> [options]\n", name);
+    printf("Options:\n");
+    printf("  --universe=dense|sparse  a fixed grid, or an unbounded universe of %dx%d tiles that only exist where cells live (default dense)\n", SPARSE_TILE_SIZE, SPARSE_TILE_SIZE);
+    printf("  --dimensions=2|3  simulate a grid of size^2 cells or a cube of size^3 voxels with a 26 cell neighborhood (default 2)\n");
+    printf("  --rule=life|R<r>,C0,M<0|1>,S<min>..<max>,B<min>..<max>|<4 digits>  Larger than Life rule with radius r,\n");
+    printf("      4 digits are the 3D rules of Bays like 4555: survive with 4..5, born with 5..5 neighbors (default life, 4555 in 3D)\n");
+    printf("  --seed=<n>  seed of the random initial grid or cube, the same seed gives the same grid for any number of processes\n");
+    printf("      and in the 3D, sparse, out-of-core and server modes (default the current time, the 2D grid then comes from rand)\n");
+    printf("  --halo=isend|persistent|neighbor|shared|rma  backend of the halo exchange (default isend)\n");
+    printf("  --halo-encoding=raw|packed|adaptive  wire format of the halo messages of isend and shared (default raw)\n");
+    printf("  --pack-transfers=true|false  send the initial grid and the result with one bit per cell (default false)\n");
+    printf("  --kernel=auto|scalar|sse2|avx2|avx512|bitpacked  update kernel of the workers (default auto: the fastest on a sample of the grid)\n");
+    printf("  --schedule=lockstep|dataflow  advance all rows generation by generation, or row band tiles as soon as their neighbors are ready (default lockstep)\n");
+    printf("  --threads=<n>  threads per worker that update the tiles of the dataflow schedule (default 2)\n");
+    printf("  --huge-pages=default|thp|hugetlb  page size of the local grids: transparent or reserved 2 MB huge pages (default default)\n");
+    printf("  --pin=true|false  bind every worker to a CPU of its node, before its grid is first touched, not with the dataflow schedule (default false)\n");
+    printf("  --counters=true|false  count cycles, instructions, cache and branch misses per phase with perf_event_open (default false)\n");
+    printf("  --pattern=<file>  load the initial grid from a .rle, .cells or 0/1 grid file instead of a random grid\n");
+    printf("  --pattern-offset=<row>,<column>  position of the pattern in the grid (default centered)\n");
+    printf("  --region=<row>,<column>,<height>,<width>[,<step>]  receive only this rectangle every output_steps generations and at the end\n");
+    printf("      instead of the grid, downsampled to one pixel per step x step cells (default the whole grid at the end)\n");
+    printf("  --region-format=jpeg|pbm  image format of the region files (default jpeg)\n");
+    printf("  --history=<k>  every worker records each generation of its rows to mpi_history-<rank>.bin, complete every k generations,\n");
+    printf("      only the changed cells in between (default off)\n");
+    printf("  --replay=<generation>  rebuild a generation from the history of a run with the same size and processes, write it or its --region\n");
+    printf("  --census=<n>  count blocks, beehives, blinkers, gliders and the other objects in place every n generations and at generation 0,\n");
+    printf("      one line per census in mpi_census-<iterations>-<width>x<height>.csv (default off)\n");
+    printf("  --out-of-core=<directory>  keep the grid of every worker in two memory mapped files in the directory on local disk,\n");
+    printf("      updated in sweeps with a few rows per generation in memory, the random grid is created by the workers (default off)\n");
+    printf("  --fuse=<n>  generations per sweep over the files of --out-of-core, the workers exchange n x radius ghost rows per sweep (default 4)\n");
+    printf("  --serve=stdin|<socket>  keep the workers running and read jobs line by line from stdin or a unix socket,\n");
+    printf("      like: size=1000 generations=500 rule=life seed=7 pattern=<file> pattern-offset=<row>,<column> image=<file> region=<row>,<column>,<height>,<width>\n");
     exit(1);
 }
 
@@ -35,17 +76,134 @@ long parseLong(char* value, char* name, long min, long max) {
     return result;
 }
 
+static bool isOption(char* arg, char* name) {
+    size_t length = strlen(name);
+    return strncmp(arg + 2, name, length) == 0 && arg[2 + length] == '=';
+}
+
+void parseOption(char* arg, GameConfig* cfg) {
+    char* value = strchr(arg, '=');
+    if (strncmp(arg, "--", 2) != 0 || value == NULL) {
+        printf("Invalid option %s, expected --name=value\n", arg);
+        exit(1);
+    }
+    value++; // skip the '='
+
+    if (isOption(arg, "universe")) {
+        cfg->universe = parseUniverse(value);
+        if (cfg->universe < 0) {
+            printf("Invalid value for universe, needs to be dense or sparse\n");
+            exit(1);
+        }
+    } else if (isOption(arg, "dimensions")) {
+        cfg->dimensions = parseLong(value, "dimensions", 2, 3);
+    } else if (isOption(arg, "rule")) {
+        if (!parseLifeRule(value, &cfg->rule)) {
+            printf("Invalid value for rule, needs to be life, R<radius>,C0,M<0|1>,S<min>..<max>,B<min>..<max> with 1 <= radius <= 500 or 4 digits\n");
+            exit(1);
+        }
+        cfg->rule_set = true;
+    } else if (isOption(arg, "seed")) {
+        cfg->seed = parseLong(value, "seed", -2147483647L - 1, 2147483647L);
+        cfg->seed_set = true;
+    } else if (isOption(arg, "halo")) {
+        cfg->halo_backend = parseHaloBackend(value);
+        if (cfg->halo_backend < 0) {
+            printf("Invalid value for halo, needs to be isend, persistent, neighbor, shared or rma\n");
+            exit(1);
+        }
+    } else if (isOption(arg, "halo-encoding")) {
+        cfg->halo_encoding = parseHaloEncoding(value);
+        if (cfg->halo_encoding < 0) {
+            printf("Invalid value for halo-encoding, needs to be raw, packed or adaptive\n");
+            exit(1);
+        }
+    } else if (isOption(arg, "pack-transfers")) {
+        cfg->pack_transfers = parseBool(value, "pack-transfers");
+    } else if (isOption(arg, "kernel")) {
+        cfg->kernel = parseUpdateKernel(value);
+        if (cfg->kernel < 0) {
+            printf("Invalid value for kernel, needs to be auto, scalar, sse2, avx2, avx512 or bitpacked\n");
+            exit(1);
+        }
+    } else if (isOption(arg, "schedule")) {
+        cfg->schedule = parseSchedule(value);
+        if (cfg->schedule < 0) {
+            printf("Invalid value for schedule, needs to be lockstep or dataflow\n");
+            exit(1);
+        }
+    } else if (isOption(arg, "threads")) {
+        cfg->threads = parseLong(value, "threads", 1, 256);
+    } else if (isOption(arg, "huge-pages")) {
+        cfg->page_mode = parsePageMode(value);
+        if (cfg->page_mode < 0) {
+            printf("Invalid value for huge-pages, needs to be default, thp or hugetlb\n");
+            exit(1);
+        }
+    } else if (isOption(arg, "pin")) {
+        cfg->pin = parseBool(value, "pin");
+    } else if (isOption(arg, "counters")) {
+        cfg->counters = parseBool(value, "counters");
+    } else if (isOption(arg, "pattern")) {
+        if (strlen(value) >= PATTERN_PATH_LENGTH) {
+            printf("Invalid value for pattern, the path can have at most %d characters\n", PATTERN_PATH_LENGTH - 1);
+            exit(1);
+        }
+        cfg->pattern_file = value;
+    } else if (isOption(arg, "pattern-offset")) {
+        if (sscanf(value, "%d,%d", &cfg->pattern_offset_y, &cfg->pattern_offset_x) != 2) {
+            printf("Invalid value for pattern-offset, needs to be <row>,<column>\n");
+            exit(1);
+        }
+        cfg->pattern_offset_set = true;
+    } else if (isOption(arg, "region")) {
+        if (!parseGridRegion(value, &cfg->region)) {
+            printf("Invalid value for region, needs to be <row>,<column>,<height>,<width>[,<step>] with a size and step of at least 1\n");
+            exit(1);
+        }
+    } else if (isOption(arg, "region-format")) {
+        cfg->region_format = parseRegionFormat(value);
+        if (cfg->region_format < 0) {
+            printf("Invalid value for region-format, needs to be jpeg or pbm\n");
+            exit(1);
+        }
+    } else if (isOption(arg, "history")) {
+        cfg->history = parseLong(value, "history", 1, 1000000);
+    } else if (isOption(arg, "replay")) {
+        cfg->replay = parseLong(value, "replay", 0, 1000000);
+    } else if (isOption(arg, "census")) {
+        cfg->census = parseLong(value, "census", 1, 1000000);
+    } else if (isOption(arg, "out-of-core")) {
+        if (value[0] == '\0' || strlen(value) >= PATTERN_PATH_LENGTH) {
+            printf("Invalid value for out-of-core, needs to be a directory with at most %d characters\n", PATTERN_PATH_LENGTH - 1);
+            exit(1);
+        }
+        cfg->out_of_core = value;
+    } else if (isOption(arg, "fuse")) {
+        cfg->fuse = parseLong(value, "fuse", 1, 1024);
+    } else if (isOption(arg, "serve")) {
+        if (value[0] == '\0') {
+            printf("Invalid value for serve, needs to be stdin or the path of a unix socket\n");
+            exit(1);
+        }
+        cfg->serve = value;
+    } else {
+        printf("Unknown option %s\n", arg);
+        exit(1);
+    }
+}
+
 GameConfig parseArguments(int argc, char** argv) {
     GameConfig cfg;
-    if(argc != 7) {
-        printf("Error: Invalid number of arguments. %d were given and 6 are expected\n", argc-1);
-        quitWithHelpMessage(argv[0]);
-    }
     //check for help flag
-    if(strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
+    if(argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
         printf("This program simulates the game of life\n");
         quitWithHelpMessage(argv[0]);
     }
+    if(argc < 7) {
+        printf("Error: Invalid number of arguments. %d were given and at least 6 are expected\n", argc-1);
+        quitWithHelpMessage(argv[0]);
+    }
 
     cfg.width = parseLong(argv[1], "grid_size", 10, 40000);
     cfg.height = cfg.width;
@@ -61,7 +219,125 @@ GameConfig parseArguments(int argc, char** argv) {
     }
     cfg.output_images = parseBool(argv[5], "output_images");
     cfg.measure_time = parseBool(argv[6], "measure_time");
-   
+
+    cfg.universe = UNIVERSE_DENSE;
+    cfg.dimensions = 2;
+    cfg.rule = conwayRule();
+    cfg.rule_set = false;
+    cfg.seed = (int)time(NULL);
+    cfg.seed_set = false;
+    cfg.halo_backend = HALO_ISEND;
+    cfg.halo_encoding = HALO_ENCODING_RAW;
+    cfg.pack_transfers = false;
+    cfg.kernel = UPDATE_KERNEL_AUTO;
+    cfg.schedule = SCHEDULE_LOCKSTEP;
+    cfg.threads = 2;
+    cfg.page_mode = PAGES_DEFAULT;
+    cfg.pin = false;
+    cfg.counters = false;
+    cfg.pattern_file = NULL;
+    cfg.pattern_offset_set = false;
+    cfg.region = (GridRegion){0, 0, 0, 0, 1, 0};
+    cfg.region_format = REGION_FORMAT_JPEG;
+    cfg.history = 0;
+    cfg.replay = -1;
+    cfg.census = 0;
+    cfg.out_of_core = NULL;
+    cfg.fuse = 4;
+    cfg.serve = NULL;
+    for (int i = 7; i < argc; i++) {
+        parseOption(argv[i], &cfg);
+    }
+    if (cfg.dimensions == 3) {
+        if (!cfg.rule_set) {
+            parseLifeRule("4555", &cfg.rule);
+        }
+        // the cube has its own exchange and update, only the placement options apply to it
+        if (cfg.halo_backend != HALO_ISEND || cfg.halo_encoding != HALO_ENCODING_RAW || cfg.pack_transfers || cfg.kernel != UPDATE_KERNEL_AUTO || cfg.pattern_file != NULL
+            || cfg.schedule != SCHEDULE_LOCKSTEP) {
+            printf("Error: halo, halo-encoding, pack-transfers, kernel, pattern and schedule only apply to the 2D grid\n");
+            exit(1);
+        }
+        if (cfg.rule.radius != 1) {
+            printf("Error: the cube supports rules with radius 1 only\n");
+            exit(1);
+        }
+        if (cfg.width > LIFE3D_MAX_SIZE) {
+            printf("Error: the cube can have a size of at most %d\n", LIFE3D_MAX_SIZE);
+            exit(1);
+        }
+    }
+    if (cfg.universe == UNIVERSE_SPARSE) {
+        // the tiles exchange their borders with MPI_Alltoallv and update with the row kernels
+        if (cfg.dimensions != 2 || !isConwayRule(&cfg.rule) || cfg.schedule != SCHEDULE_LOCKSTEP || cfg.halo_backend != HALO_ISEND
+            || cfg.halo_encoding != HALO_ENCODING_RAW || cfg.pack_transfers) {
+            printf("Error: the sparse universe supports Conway's Game of Life in 2D only, without halo, halo-encoding, pack-transfers and schedule\n");
+            exit(1);
+        }
+    }
+    int neighborhood = cfg.dimensions == 3 ? 27 : (2 * cfg.rule.radius + 1) * (2 * cfg.rule.radius + 1);
+    if (cfg.rule.survive_max > neighborhood || cfg.rule.birth_max > neighborhood) {
+        printf("Error: the rule counts more than the %d cells of its neighborhood\n", neighborhood);
+        exit(1);
+    }
+    if (hasGridRegion(&cfg.region)) {
+        if (cfg.dimensions != 2 || cfg.universe != UNIVERSE_DENSE || cfg.serve != NULL) {
+            printf("Error: region applies to a run of the dense 2D grid, server jobs have their own region\n");
+            exit(1);
+        }
+        if (cfg.region.row + cfg.region.height > cfg.height || cfg.region.column + cfg.region.width > cfg.width) {
+            printf("Error: the region does not fit into the grid of %d x %d cells\n", cfg.width, cfg.height);
+            exit(1);
+        }
+        cfg.region.every = cfg.output_steps > 0 ? cfg.output_steps : 0;
+    }
+    if ((cfg.history > 0 || cfg.replay >= 0) && (cfg.dimensions != 2 || cfg.universe != UNIVERSE_DENSE || cfg.serve != NULL)) {
+        printf("Error: history and replay apply to a run of the dense 2D grid\n");
+        exit(1);
+    }
+    if (cfg.history > 0 && cfg.schedule != SCHEDULE_LOCKSTEP) {
+        printf("Error: the history records every generation, it needs the lockstep schedule\n");
+        exit(1);
+    }
+    if (cfg.replay >= 0) {
+        if (cfg.history > 0 || cfg.pattern_file != NULL) {
+            printf("Error: a replay reads the history, it cannot record one or load a pattern\n");
+            exit(1);
+        }
+        // the images are named after the rebuilt generation
+        cfg.total_iterations = cfg.replay;
+        cfg.region.every = 0;
+    }
+    if (cfg.census > 0 && (cfg.dimensions != 2 || cfg.universe != UNIVERSE_DENSE || cfg.serve != NULL || cfg.replay >= 0)) {
+        printf("Error: the census applies to a run of the dense 2D grid, not to serve or replay\n");
+        exit(1);
+    }
+    if (cfg.out_of_core != NULL && (cfg.dimensions != 2 || cfg.universe != UNIVERSE_DENSE || cfg.schedule != SCHEDULE_LOCKSTEP || cfg.halo_backend != HALO_ISEND
+        || cfg.halo_encoding != HALO_ENCODING_RAW || cfg.history > 0 || cfg.replay >= 0 || cfg.serve != NULL)) {
+        printf("Error: out-of-core runs the dense 2D grid with its own sweeps and exchange, without schedule, halo, halo-encoding, history, replay and serve\n");
+        exit(1);
+    }
+    if (cfg.serve != NULL && (cfg.dimensions != 2 || cfg.universe != UNIVERSE_DENSE || cfg.pattern_file != NULL)) {
+        printf("Error: the server runs jobs on the dense 2D grid, every job names its own pattern\n");
+        exit(1);
+    }
+    if (cfg.halo_encoding != HALO_ENCODING_RAW && cfg.halo_backend != HALO_ISEND && cfg.halo_backend != HALO_SHARED) {
+        printf("Error: halo-encoding %s needs messages of variable size, only the isend and shared backends support it\n", haloEncodingName(cfg.halo_encoding));
+        exit(1);
+    }
+    if (cfg.schedule == SCHEDULE_DATAFLOW && (cfg.halo_backend != HALO_ISEND || cfg.halo_encoding != HALO_ENCODING_RAW)) {
+        printf("Error: the dataflow schedule sends its own halo messages, halo and halo-encoding do not apply to it\n");
+        exit(1);
+    }
+    if (cfg.schedule == SCHEDULE_DATAFLOW && cfg.pin) {
+        // the threads would inherit the single CPU of the worker, and any of them updates any tile, so no thread could first touch its rows
+        printf("Error: pin binds a worker to one CPU, all threads of the dataflow schedule would share it\n");
+        exit(1);
+    }
+    if (cfg.kernel != UPDATE_KERNEL_AUTO && !isConwayRule(&cfg.rule)) {
+        printf("Error: the update kernels compute Conway's Game of Life, other rules always use the Larger than Life update\n");
+        exit(1);
+    }
 
 
     if(cfg.output_images && cfg.total_iterations / cfg.output_steps > 10) {
@@ -69,11 +345,54 @@ GameConfig parseArguments(int argc, char** argv) {
         exit(1);
     }
 
+    if (cfg.serve != NULL && strcmp(cfg.serve, "stdin") == 0) {
+        reserveStdoutForAnswers(); // the title and everything after it goes to stderr
+    }
+
     //print title and parsed arguments
     printf("***************************\n");
     printf("* Game of Life Simulation *\n");
     printf("***************************\n");
+    if (cfg.universe == UNIVERSE_SPARSE) {
+        printf("universe: sparse, %dx%d tiles%s\n", SPARSE_TILE_SIZE, SPARSE_TILE_SIZE, cfg.pattern_file == NULL ? ", random square at 0,0" : "");
+    }
+    if (cfg.dimensions == 3) {
+        printf("dimensions: 3, a cube of %d x %d x %d voxels; seed: %d\n", cfg.width, cfg.height, cfg.width, cfg.seed);
+    }
     printf("size: %d x %d; total_iterations: %d; output steps: %d; console_output: %s; output images: %s; measure time: %s\n", cfg.width, cfg.height, cfg.total_iterations, cfg.output_steps, cfg.console_output ? "true" : "false", cfg.output_images ? "true" : "false", cfg.measure_time ? "true" : "false");
+    char rule_name[64];
+    formatLifeRule(&cfg.rule, rule_name, sizeof(rule_name));
+    printf("rule: %s%s\n", rule_name, isConwayRule(&cfg.rule) ? " (Conway's Game of Life)" : "");
+    if (cfg.seed_set && cfg.dimensions == 2 && cfg.out_of_core == NULL) { // the others print the seed they use anyway
+        printf("seed: %d\n", cfg.seed);
+    }
+    printf("halo exchange: %s; halo encoding: %s; pack transfers: %s; kernel: %s\n", haloBackendName(cfg.halo_backend), haloEncodingName(cfg.halo_encoding), cfg.pack_transfers ? "true" : "false", updateKernelName(cfg.kernel));
+    printf("huge pages: %s; pin: %s; counters: %s\n", pageModeName(cfg.page_mode), cfg.pin ? "true" : "false", cfg.counters ? "true" : "false");
+    if (cfg.schedule == SCHEDULE_DATAFLOW) {
+        printf("schedule: dataflow with %d threads per worker\n", cfg.threads);
+    }
+    if (cfg.pattern_file != NULL) {
+        printf("pattern: %s\n", cfg.pattern_file);
+    }
+    if (hasGridRegion(&cfg.region)) {
+        printf("region: %d x %d cells at %d,%d, step %d, every %d generations, %s\n", cfg.region.width, cfg.region.height, cfg.region.row, cfg.region.column,
+            cfg.region.step, cfg.region.every > 0 ? cfg.region.every : cfg.total_iterations, regionFormatName(cfg.region_format));
+    }
+    if (cfg.history > 0) {
+        printf("history: every generation to mpi_history-<rank>.bin, a keyframe every %d generations\n", cfg.history);
+    }
+    if (cfg.census > 0) {
+        printf("census: every %d generations to mpi_census-%d-%dx%d.csv\n", cfg.census, cfg.total_iterations, cfg.width, cfg.height);
+    }
+    if (cfg.replay >= 0) {
+        printf("replay: generation %d from mpi_history-<rank>.bin\n", cfg.replay);
+    }
+    if (cfg.out_of_core != NULL) {
+        printf("out-of-core: partition files in %s, %d generations per sweep; seed: %d\n", cfg.out_of_core, cfg.fuse, cfg.seed);
+    }
+    if (cfg.serve != NULL) {
+        printf("serve: jobs from %s, size, total_iterations and rule are their defaults\n", cfg.serve);
+    }
     printf("\n");
     return cfg;
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 
 #include <stdbool.h>
 
+#include "life_rule.h"
+#include "region_query.h"
+
 /**
  * Configuration of the game of life
 */
@@ -13,10 +16,40 @@ struct GameConfig{
     bool console_output; // print grid to console
     bool output_images;  // output images of the grid
     bool measure_time;  // measure time of the simulation
+
+    // optional arguments in the form --name=value after the positional ones
+    int universe;  // Universe, --universe, UNIVERSE_SPARSE is unbounded and only stores the alive tiles
+    int dimensions;  // 2 for the grid, 3 for a cube of size^3 voxels, --dimensions
+    LifeRule rule;  // Larger than Life rule, --rule, Conway's Game of Life by default, 4555 in 3D
+    bool rule_set;
+    int seed;  // seed of the random initial grid or cube, --seed, the current time by default
+    bool seed_set;
+    int halo_backend;  // HaloBackend of the per generation exchange, --halo
+    int halo_encoding;  // HaloEncoding of the halo messages, --halo-encoding
+    bool pack_transfers;  // bit-pack the initial grid and the result, --pack-transfers
+    int page_mode;  // PageMode of the local grids of the workers, --huge-pages
+    bool pin;  // bind every worker to a CPU, --pin
+    bool counters;  // hardware counters per phase with perf_event_open, --counters
+    int schedule;  // Schedule of the workers, --schedule
+    int threads;  // threads per worker that update tiles with SCHEDULE_DATAFLOW, --threads
+    int kernel;  // UpdateKernelId of the workers, --kernel, UPDATE_KERNEL_AUTO lets them benchmark the kernels
+    char* pattern_file;  // pattern the workers load instead of a random grid, --pattern
+    int pattern_offset_y;  // position of the pattern in the grid, --pattern-offset, centered by default
+    int pattern_offset_x;
+    bool pattern_offset_set;
+    GridRegion region;  // rectangle the main process receives every output_steps generations instead of the grid, --region
+    int region_format;  // RegionFormat of the region files, --region-format
+    int history;  // keyframe interval of the history every worker records, --history, 0 records nothing
+    int replay;  // generation rebuilt from the history instead of a run, --replay, -1 runs the game
+    int census;  // generations between two censuses of the objects on the grid, --census, 0 takes none
+    char* out_of_core;  // directory of the memory mapped partition files of the workers, --out-of-core, NULL keeps the grid in memory
+    int fuse;  // generations per sweep over the partition files, --fuse
+    char* serve;  // "stdin" or the path of a unix socket the main process reads jobs from, --serve, NULL runs the arguments once
 };
 typedef struct GameConfig GameConfig;
 
 void quitWithHelpMessage(char* name);
 bool parseBool(char* value, char* name);
 long parseLong(char* value, char* name, long min, long max);
+void parseOption(char* arg, GameConfig* cfg);
 GameConfig parseArguments(int argc, char** argv);
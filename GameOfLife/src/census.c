@@ -0,0 +1,641 @@
+#include "census.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h> // memcpy
+
+#include "utils.h"
+
+
+#define CENSUS_TAG 3
+// counts of the kinds and the population, reduced to the main process
+#define CENSUS_COUNT_FIELDS (CENSUS_KIND_COUNT + 1)
+// multiplied with eight cells of 0 or 1 in a little-endian word, moves the cell of byte k to bit 56 + k
+#define CENSUS_PACK 0x0102040810204080ULL
+
+
+/**
+ * A shape in its bounding box, bit row * width + column is a live cell
+ */
+struct CensusShape {
+    int height;
+    int width;
+    uint64_t cells;
+};
+typedef struct CensusShape CensusShape;
+
+/**
+ * The objects of the census in all their phases, rows separated by '/', the orientation does not matter
+ */
+static const struct {
+    int kind;
+    const char* cells;
+} census_table[] = {
+    {CENSUS_BLOCK, "oo/oo"},
+    {CENSUS_BEEHIVE, ".oo./o..o/.oo."},
+    {CENSUS_LOAF, ".oo./o..o/.o.o/..o."},
+    {CENSUS_BOAT, "oo./o.o/.o."},
+    {CENSUS_TUB, ".o./o.o/.o."},
+    {CENSUS_POND, ".oo./o..o/o..o/.oo."},
+    {CENSUS_SHIP, "oo./o.o/.oo"},
+    {CENSUS_BLINKER, "ooo"},
+    {CENSUS_TOAD, ".ooo/ooo."},
+    {CENSUS_TOAD, "..o./o..o/o..o/.o.."},
+    {CENSUS_BEACON, "oo../oo../..oo/..oo"},
+    {CENSUS_BEACON, "oo../o.../...o/..oo"},
+    {CENSUS_GLIDER, ".o./..o/ooo"},
+    {CENSUS_GLIDER, "o.o/.oo/.o."},
+    {CENSUS_LWSS, ".o..o/o..../o...o/oooo."},
+    {CENSUS_LWSS, "..oo./oo.oo/oooo./.oo.."},
+};
+#define CENSUS_TABLE_SIZE (int)(sizeof(census_table) / sizeof(census_table[0]))
+
+// every orientation of every shape of the table, hashed by its bounding box and cells. Open addressing, at most half full
+#define CENSUS_INDEX_SIZE 256
+static struct {
+    CensusShape shape;
+    int kind;
+} census_index[CENSUS_INDEX_SIZE];
+static bool census_index_ready = false;
+// objects with fewer or more cells than the shapes of the table are not looked up, nor the ones whose bounding box is no
+// bounding box of the table, bit w of census_widths[h] is set for a shape of height h and width w
+static int census_min_cells, census_max_cells;
+static int census_widths[CENSUS_MAX_SIDE + 1];
+
+static const char* census_kind_names[CENSUS_KIND_COUNT] = {"block", "beehive", "loaf", "boat", "tub", "pond", "ship", "blinker", "toad", "beacon",
+    "glider", "lwss", "other"};
+
+const char* censusKindName(int kind) {
+    return kind >= 0 && kind < CENSUS_KIND_COUNT ? census_kind_names[kind] : "unknown";
+}
+
+
+/**
+ * One of the 8 rotations and reflections: transposed with bit 4, rows and columns reversed with bit 1 and 2
+ */
+static CensusShape orientShape(CensusShape shape, int symmetry) {
+    bool transpose = symmetry & 4;
+    CensusShape oriented = {transpose ? shape.width : shape.height, transpose ? shape.height : shape.width, 0};
+    for (uint64_t cells = shape.cells; cells != 0; cells &= cells - 1) {
+        int bit = __builtin_ctzll(cells);
+        int r = bit / shape.width, c = bit % shape.width;
+        int row = transpose ? c : r, column = transpose ? r : c;
+        if (symmetry & 1) {
+            row = oriented.height - 1 - row;
+        }
+        if (symmetry & 2) {
+            column = oriented.width - 1 - column;
+        }
+        oriented.cells |= (uint64_t)1 << (row * oriented.width + column);
+    }
+    return oriented;
+}
+
+static int shapeSlot(CensusShape shape) {
+    uint64_t hash = (shape.cells ^ ((uint64_t)shape.height << 56) ^ ((uint64_t)shape.width << 60)) * 0x9E3779B97F4A7C15ULL;
+    return hash >> 56; // CENSUS_INDEX_SIZE slots
+}
+
+static bool sameShape(CensusShape a, CensusShape b) {
+    return a.height == b.height && a.width == b.width && a.cells == b.cells;
+}
+
+/**
+ * Parses a shape of the table, rows of '.' and 'o' separated by '/'
+ */
+static CensusShape parseCensusShape(const char* text) {
+    CensusShape shape = {1, 0, 0};
+    int column = 0;
+    for (const char* cell = text; *cell != '\0'; cell++) {
+        if (*cell == '/') {
+            shape.height++;
+            column = 0;
+        } else {
+            shape.width = max(shape.width, ++column);
+        }
+    }
+    int row = 0;
+    column = 0;
+    for (const char* cell = text; *cell != '\0'; cell++) {
+        if (*cell == '/') {
+            row++;
+            column = 0;
+            continue;
+        }
+        if (*cell == 'o') {
+            shape.cells |= (uint64_t)1 << (row * shape.width + column);
+        }
+        column++;
+    }
+    return shape;
+}
+
+static void prepareCensusTable(void) {
+    if (census_index_ready) {
+        return;
+    }
+    census_min_cells = CENSUS_MAX_SIDE * CENSUS_MAX_SIDE;
+    census_max_cells = 0;
+    for (int i = 0; i < CENSUS_TABLE_SIZE; i++) {
+        CensusShape shape = parseCensusShape(census_table[i].cells);
+        census_min_cells = min(census_min_cells, __builtin_popcountll(shape.cells));
+        census_max_cells = max(census_max_cells, __builtin_popcountll(shape.cells));
+        for (int symmetry = 0; symmetry < 8; symmetry++) {
+            CensusShape oriented = orientShape(shape, symmetry);
+            int slot = shapeSlot(oriented);
+            while (census_index[slot].shape.height != 0 && !sameShape(census_index[slot].shape, oriented)) {
+                slot = (slot + 1) % CENSUS_INDEX_SIZE;
+            }
+            census_index[slot].shape = oriented;
+            census_index[slot].kind = census_table[i].kind;
+            census_widths[oriented.height] |= 1 << oriented.width;
+        }
+    }
+    census_index_ready = true;
+}
+
+
+/**
+ * A horizontal run of live cells, the runs of an object are joined with union-find. The workers merge the runs of a row
+ * that are at most CENSUS_DISTANCE apart into one, the main process gets the runs of the fragments as they are
+ *
+ * @param row The row in the main grid
+ * @param start The first column, a live cell
+ * @param end The last column, a live cell
+ * @param cells The live cells from start to end
+ * @param parent The run this one is joined to, itself for the root, which is the first run of the object
+ * @param big The run belongs to an object too large for the table, only the runs along the boundary are known
+ */
+struct CensusRun {
+    int row;
+    int start;
+    int end;
+    int cells;
+    int parent;
+    int big;
+};
+typedef struct CensusRun CensusRun;
+
+/**
+ * An object: its bounding box, its cells and its runs from first_run to last_run, linked through next
+ */
+struct CensusObject {
+    int first_run;
+    int last_run;
+    int top;
+    int bottom;
+    int left;
+    int right;
+    long long cells;
+    bool big;
+};
+typedef struct CensusObject CensusObject;
+
+/**
+ * The runs and objects of a census. The buffers are kept from one census to the next, the ones of next, object_of_root
+ * and objects have the capacity of the runs
+ */
+struct CensusLabels {
+    CensusRun* runs;
+    int run_count;
+    int run_capacity;
+    int* next; // the next run of the same object, -1 at the end
+    int* object_of_root;
+    CensusObject* objects;
+    int object_count;
+    uint64_t* bits; // the packed cells of a row, column c is bit c % 64 of word c / 64, and a word of dead cells after them
+    int bit_capacity;
+    int* fragments;
+    int fragment_capacity;
+};
+typedef struct CensusLabels CensusLabels;
+
+static CensusLabels census_labels = {NULL, 0, 0, NULL, NULL, NULL, 0, NULL, 0, NULL, 0};
+
+
+static void* resizeCensusBuffer(void* buffer, size_t size) {
+    buffer = realloc(buffer, size);
+    if (buffer == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the census\n");
+        exit(1);
+    }
+    return buffer;
+}
+
+
+static int findRun(CensusRun* runs, int run) {
+    while (runs[run].parent != run) {
+        runs[run].parent = runs[runs[run].parent].parent;
+        run = runs[run].parent;
+    }
+    return run;
+}
+
+static void joinRuns(CensusRun* runs, int a, int b) {
+    a = findRun(runs, a);
+    b = findRun(runs, b);
+    // the earlier run stays the root, it is the top left of the object
+    if (a < b) {
+        runs[b].parent = a;
+    } else if (b < a) {
+        runs[a].parent = b;
+    }
+}
+
+static int addRun(CensusLabels* labels, int row, int start, int end, int cells, int big) {
+    if (labels->run_count == labels->run_capacity) {
+        labels->run_capacity = labels->run_capacity == 0 ? 1024 : 2 * labels->run_capacity;
+        labels->runs = resizeCensusBuffer(labels->runs, labels->run_capacity * sizeof(CensusRun));
+        labels->next = resizeCensusBuffer(labels->next, labels->run_capacity * sizeof(int));
+        labels->object_of_root = resizeCensusBuffer(labels->object_of_root, labels->run_capacity * sizeof(int));
+        labels->objects = resizeCensusBuffer(labels->objects, labels->run_capacity * sizeof(CensusObject));
+    }
+    int run = labels->run_count++;
+    labels->runs[run] = (CensusRun){row, start, end, cells, run, big};
+    return run;
+}
+
+/**
+ * Joins the runs of a row with the runs of a row up to CENSUS_DISTANCE above that are at most CENSUS_DISTANCE columns away.
+ * The runs of a row are consecutive and sorted by column
+ */
+static void joinRows(CensusRun* runs, int above_first, int above_end, int row_first, int row_end) {
+    int a = above_first;
+    for (int i = row_first; i < row_end; i++) {
+        while (a < above_end && runs[a].end < runs[i].start - CENSUS_DISTANCE) {
+            a++;
+        }
+        int root = findRun(runs, i);
+        for (int j = a; j < above_end && runs[j].start <= runs[i].end + CENSUS_DISTANCE; j++) {
+            // the same as joinRuns, the root of the run is kept
+            int other = findRun(runs, j);
+            if (other < root) {
+                runs[root].parent = other;
+                root = other;
+            } else if (root < other) {
+                runs[other].parent = root;
+            }
+        }
+    }
+}
+
+/**
+ * Groups the joined runs into objects, the root of an object comes before its other runs. A parent comes before its run
+ * too, in the order of the runs the parent of the parent is the root
+ */
+static void collectObjects(CensusLabels* labels) {
+    int count = labels->run_count;
+    int* object_of_root = labels->object_of_root;
+    labels->object_count = 0;
+    for (int i = 0; i < count; i++) {
+        CensusRun* run = &labels->runs[i];
+        int root = labels->runs[run->parent].parent;
+        run->parent = root;
+        labels->next[i] = -1;
+        if (root == i) {
+            object_of_root[i] = labels->object_count;
+            labels->objects[labels->object_count++] = (CensusObject){i, i, run->row, run->row, run->start, run->end, 0, false};
+        }
+        CensusObject* object = &labels->objects[object_of_root[root]];
+        if (root != i) {
+            labels->next[object->last_run] = i;
+            object->last_run = i;
+        }
+        object->top = min(object->top, run->row);
+        object->bottom = max(object->bottom, run->row);
+        object->left = min(object->left, run->start);
+        object->right = max(object->right, run->end);
+        object->cells += run->cells;
+        object->big |= run->big;
+    }
+}
+
+void freeCensusBuffers(void) {
+    free(census_labels.runs);
+    free(census_labels.next);
+    free(census_labels.object_of_root);
+    free(census_labels.objects);
+    free(census_labels.bits);
+    free(census_labels.fragments);
+    census_labels = (CensusLabels){NULL, 0, 0, NULL, NULL, NULL, 0, NULL, 0, NULL, 0};
+}
+
+/**
+ * Matches the shape of an object, normalised to its bounding box, against the table. The cells are read from the rows
+ * of the grid if there is one, grid_row is the row of the grid of row 0 of the main grid, else from the runs
+ */
+static int classifyObject(const CensusLabels* labels, const CensusObject* object, unsigned char** grid, int grid_row) {
+    CensusShape shape = {object->bottom - object->top + 1, object->right - object->left + 1, 0};
+    if (object->big || shape.height > CENSUS_MAX_SIDE || shape.width > CENSUS_MAX_SIDE || !(census_widths[shape.height] >> shape.width & 1)
+        || object->cells < census_min_cells || object->cells > census_max_cells) {
+        return CENSUS_OTHER;
+    }
+    if (grid != NULL) {
+        for (int r = 0; r < shape.height; r++) {
+            uint64_t word = 0;
+            memcpy(&word, grid[grid_row + object->top + r] + object->left, shape.width);
+            shape.cells |= (word * CENSUS_PACK >> 56) << (r * shape.width);
+        }
+    } else {
+        for (int run = object->first_run; run >= 0; run = labels->next[run]) {
+            const CensusRun* r = &labels->runs[run];
+            shape.cells |= (((uint64_t)1 << (r->end - r->start + 1)) - 1) << ((r->row - object->top) * shape.width + r->start - object->left);
+        }
+    }
+    for (int slot = shapeSlot(shape); census_index[slot].shape.height != 0; slot = (slot + 1) % CENSUS_INDEX_SIZE) {
+        if (sameShape(census_index[slot].shape, shape)) {
+            return census_index[slot].kind;
+        }
+    }
+    return CENSUS_OTHER;
+}
+
+
+static void reserveFragments(CensusLabels* labels, int needed) {
+    if (needed > labels->fragment_capacity) {
+        labels->fragment_capacity = max(2 * labels->fragment_capacity, needed);
+        labels->fragments = resizeCensusBuffer(labels->fragments, labels->fragment_capacity * sizeof(int));
+    }
+}
+
+/**
+ * Packs count cells into labels->bits, eight at a time, and clears the word after them
+ */
+static void packCensusRow(CensusLabels* labels, const unsigned char* cells, int count) {
+    uint64_t* bits = labels->bits;
+    int w = 0;
+    for (; (w + 1) * 64 <= count; w++) {
+        uint64_t packed = 0;
+        for (int k = 0; k < 8; k++) {
+            uint64_t word;
+            memcpy(&word, cells + w * 64 + k * 8, 8);
+            packed |= (word * CENSUS_PACK >> 56) << (8 * k);
+        }
+        bits[w] = packed;
+    }
+    bits[w] = 0;
+    bits[w + 1] = 0;
+    for (int j = w * 64; j < count; j += 8) {
+        uint64_t word = 0;
+        memcpy(&word, cells + j, min(8, count - j));
+        bits[w] |= (word * CENSUS_PACK >> 56) << (j % 64);
+    }
+}
+
+/**
+ * The next run of the packed cells that starts at column or after it
+ *
+ * @param end Set to the last column of the run
+ * @return The first column of the run, count if there is none
+ */
+static int nextRun(const uint64_t* bits, int count, int column, int* end) {
+    int word = column / 64;
+    uint64_t live = bits[word] & (~(uint64_t)0 << (column % 64));
+    while (live == 0) {
+        if (++word * 64 >= count) {
+            return count;
+        }
+        live = bits[word];
+    }
+    int start = word * 64 + __builtin_ctzll(live);
+    uint64_t dead = ~bits[word] & (~(uint64_t)0 << (start % 64));
+    while (dead == 0) {
+        dead = ~bits[++word]; // the cleared word after the cells ends the last run
+    }
+    *end = word * 64 + __builtin_ctzll(dead) - 1;
+    return start;
+}
+
+/**
+ * Adds the runs of live cells of a row, the runs at most CENSUS_DISTANCE apart merged into one
+ */
+static void addRowRuns(CensusLabels* labels, const unsigned char* cells, int width, int row) {
+    packCensusRow(labels, cells, width);
+    int end, next_end;
+    int start = nextRun(labels->bits, width, 0, &end);
+    while (start < width) {
+        int count = end - start + 1;
+        int next = nextRun(labels->bits, width, end + 1, &next_end);
+        while (next < width && next - end <= CENSUS_DISTANCE) {
+            count += next_end - next + 1;
+            end = next_end;
+            next = nextRun(labels->bits, width, end + 1, &next_end);
+        }
+        addRun(labels, row, start, end, count, 0);
+        start = next;
+        end = next_end;
+    }
+}
+
+/**
+ * Appends the runs of live cells from column start to end of a row to the fragments, as <row> <start> <end>
+ *
+ * @return The number of runs
+ */
+static int addFragmentRuns(CensusLabels* labels, int* fragment_size, const unsigned char* cells, int row, int start, int end) {
+    int count = end - start + 1, runs = 0;
+    packCensusRow(labels, cells + start, count);
+    int run_end;
+    for (int run = nextRun(labels->bits, count, 0, &run_end); run < count; run = nextRun(labels->bits, count, run_end + 1, &run_end)) {
+        reserveFragments(labels, *fragment_size + 3);
+        labels->fragments[(*fragment_size)++] = row;
+        labels->fragments[(*fragment_size)++] = start + run;
+        labels->fragments[(*fragment_size)++] = start + run_end;
+        runs++;
+    }
+    return runs;
+}
+
+
+void takeCensus(WorkerConfig cfg) {
+    prepareCensusTable();
+    CensusLabels* labels = &census_labels;
+    labels->run_count = 0;
+    if (labels->bit_capacity < cfg.grid_width / 64 + 2) {
+        labels->bit_capacity = cfg.grid_width / 64 + 2;
+        labels->bits = resizeCensusBuffer(labels->bits, labels->bit_capacity * sizeof(uint64_t));
+    }
+    const int first_row = cfg.row_index_main_grid;
+    const int last_row = first_row + cfg.update_row_count - 1;
+    // the runs of the CENSUS_DISTANCE rows above, [first, end) per row, the row right above first
+    int above_first[CENSUS_DISTANCE] = {0}, above_end[CENSUS_DISTANCE] = {0};
+    for (int i = 0; i < cfg.update_row_count; i++) {
+        int row_first = labels->run_count;
+        addRowRuns(labels, cfg.local_grid[cfg.update_start_row + i], cfg.grid_width, first_row + i);
+        for (int d = 0; d < CENSUS_DISTANCE; d++) {
+            joinRows(labels->runs, above_first[d], above_end[d], row_first, labels->run_count);
+        }
+        for (int d = CENSUS_DISTANCE - 1; d > 0; d--) {
+            above_first[d] = above_first[d - 1];
+            above_end[d] = above_end[d - 1];
+        }
+        above_first[0] = row_first;
+        above_end[0] = labels->run_count;
+    }
+    collectObjects(labels);
+
+    // the objects inside the rows are counted here, the ones within CENSUS_DISTANCE of a neighbor are sent as fragments:
+    // <big> <run count> followed by <row> <start> <end> per run of live cells, only the runs along the boundary of a big one
+    const bool lower = cfg.world_rank > 1;
+    const bool upper = cfg.world_rank < cfg.world_size - 1;
+    const int grid_row = cfg.update_start_row - first_row;
+    long long counts[CENSUS_COUNT_FIELDS] = {0};
+    int fragment_size = 0;
+    for (int o = 0; o < labels->object_count; o++) {
+        CensusObject* object = &labels->objects[o];
+        counts[CENSUS_KIND_COUNT] += object->cells;
+        bool near_lower = lower && object->top < first_row + CENSUS_DISTANCE;
+        bool near_upper = upper && object->bottom > last_row - CENSUS_DISTANCE;
+        if (!near_lower && !near_upper) {
+            counts[classifyObject(labels, object, cfg.local_grid, grid_row)]++;
+            continue;
+        }
+        bool big = object->bottom - object->top >= CENSUS_MAX_SIDE || object->right - object->left >= CENSUS_MAX_SIDE;
+        int header = fragment_size;
+        reserveFragments(labels, fragment_size + 2);
+        labels->fragments[fragment_size++] = big;
+        labels->fragments[fragment_size++] = 0;
+        for (int run = object->first_run; run >= 0; run = labels->next[run]) {
+            const CensusRun* r = &labels->runs[run];
+            if (big && r->row >= first_row + CENSUS_DISTANCE && r->row <= last_row - CENSUS_DISTANCE) {
+                continue;
+            }
+            int runs = addFragmentRuns(labels, &fragment_size, cfg.local_grid[grid_row + r->row], r->row, r->start, r->end);
+            labels->fragments[header + 1] += runs;
+        }
+    }
+
+    MPI_Send(labels->fragments, fragment_size, MPI_INT, 0, CENSUS_TAG, MPI_COMM_WORLD);
+    MPI_Reduce(counts, NULL, CENSUS_COUNT_FIELDS, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+}
+
+
+static int compareRuns(const void* a, const void* b) {
+    const CensusRun* x = a;
+    const CensusRun* y = b;
+    if (x->row != y->row) {
+        return x->row < y->row ? -1 : 1;
+    }
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+/**
+ * Receives the fragments of all workers and joins the ones that touch across the boundaries, the objects are counted in counts
+ */
+static void mergeFragments(CensusLog* log, long long counts[CENSUS_COUNT_FIELDS]) {
+    CensusLabels* labels = &census_labels;
+    labels->run_count = 0;
+    int fragment_count = 0;
+    for (int rank = 1; rank < log->world_size; rank++) {
+        MPI_Status status;
+        int size;
+        MPI_Probe(rank, CENSUS_TAG, MPI_COMM_WORLD, &status);
+        MPI_Get_count(&status, MPI_INT, &size);
+        reserveFragments(labels, max(size, 1));
+        const int* fragments = labels->fragments;
+        MPI_Recv(labels->fragments, size, MPI_INT, rank, CENSUS_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        for (int i = 0; i < size; fragment_count++) {
+            int big = fragments[i], run_count = fragments[i + 1];
+            i += 2;
+            for (int r = 0; r < run_count; r++, i += 3) {
+                // the parent holds the fragment until the runs are sorted
+                int run = addRun(labels, fragments[i], fragments[i + 1], fragments[i + 2], fragments[i + 2] - fragments[i + 1] + 1, big);
+                labels->runs[run].parent = fragment_count;
+            }
+        }
+    }
+
+    double start = MPI_Wtime();
+    // sorted by row, the runs of a fragment are joined and then the rows of the workers along their boundaries
+    qsort(labels->runs, labels->run_count, sizeof(CensusRun), compareRuns);
+    int* fragment_run = malloc(max(fragment_count, 1) * sizeof(int));
+    if (fragment_run == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the census\n");
+        exit(1);
+    }
+    for (int f = 0; f < fragment_count; f++) {
+        fragment_run[f] = -1;
+    }
+    for (int i = 0; i < labels->run_count; i++) {
+        int fragment = labels->runs[i].parent;
+        labels->runs[i].parent = i;
+        if (fragment_run[fragment] < 0) {
+            fragment_run[fragment] = i;
+        } else {
+            joinRuns(labels->runs, fragment_run[fragment], i);
+        }
+    }
+    free(fragment_run);
+    int above_first[CENSUS_DISTANCE] = {0}, above_end[CENSUS_DISTANCE] = {0};
+    for (int i = 0; i < labels->run_count;) {
+        int row_first = i;
+        while (i < labels->run_count && labels->runs[i].row == labels->runs[row_first].row) {
+            i++;
+        }
+        for (int d = 0; d < CENSUS_DISTANCE; d++) {
+            if (above_end[d] > above_first[d] && labels->runs[row_first].row - labels->runs[above_first[d]].row <= CENSUS_DISTANCE) {
+                joinRows(labels->runs, above_first[d], above_end[d], row_first, i);
+            }
+        }
+        for (int d = CENSUS_DISTANCE - 1; d > 0; d--) {
+            above_first[d] = above_first[d - 1];
+            above_end[d] = above_end[d - 1];
+        }
+        above_first[0] = row_first;
+        above_end[0] = i;
+    }
+    collectObjects(labels);
+    for (int o = 0; o < labels->object_count; o++) {
+        counts[classifyObject(labels, &labels->objects[o], NULL, 0)]++;
+    }
+    log->merge_time += MPI_Wtime() - start;
+}
+
+
+void openCensusLog(CensusLog* log, const char* file_name, int interval, int total_iterations, int world_size) {
+    prepareCensusTable();
+    log->file = fopen(file_name, "w");
+    if (log->file == NULL) {
+        fprintf(stderr, "Error: cannot create the census log %s\n", file_name);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    fprintf(log->file, "generation,objects,population");
+    for (int kind = 0; kind < CENSUS_KIND_COUNT; kind++) {
+        fprintf(log->file, ",%s", censusKindName(kind));
+    }
+    fprintf(log->file, "\n");
+    log->interval = interval;
+    log->next_generation = 0;
+    log->total_iterations = total_iterations;
+    log->world_size = world_size;
+    log->censuses = 0;
+    log->merge_time = 0;
+}
+
+
+void receiveCensuses(CensusLog* log, int generation) {
+    while (log->next_generation <= generation && log->next_generation <= log->total_iterations) {
+        long long counts[CENSUS_COUNT_FIELDS] = {0};
+        mergeFragments(log, counts);
+        long long zeros[CENSUS_COUNT_FIELDS] = {0}, totals[CENSUS_COUNT_FIELDS];
+        MPI_Reduce(zeros, totals, CENSUS_COUNT_FIELDS, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        long long objects = 0;
+        for (int kind = 0; kind < CENSUS_KIND_COUNT; kind++) {
+            counts[kind] += totals[kind];
+            objects += counts[kind];
+        }
+        fprintf(log->file, "%d,%lld,%lld", log->next_generation, objects, totals[CENSUS_KIND_COUNT]);
+        for (int kind = 0; kind < CENSUS_KIND_COUNT; kind++) {
+            fprintf(log->file, ",%lld", counts[kind]);
+        }
+        fprintf(log->file, "\n");
+        log->censuses++;
+        log->next_generation += log->interval;
+    }
+}
+
+
+void closeCensusLog(CensusLog* log) {
+    fclose(log->file);
+    freeCensusBuffers();
+}
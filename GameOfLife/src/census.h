@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "game_of_life_mpi.h"
+
+// the census log of the main process, %d are the total iterations, the width and the height
+#define CENSUS_FILE_NAME "mpi_census-%d-%dx%d.csv"
+// live cells at most this far apart (in rows and columns) belong to the same object. At 1 the phases of the toad,
+// the beacon and the lwss that are not 8-connected would fall apart, and objects this close interact anyway
+#define CENSUS_DISTANCE 2
+// objects with a larger bounding box are counted as other, the shapes of the table fit into 64 bits
+#define CENSUS_MAX_SIDE 8
+
+/**
+ * What an object of the census is, matched by its shape in any of its phases, rotations and reflections
+ */
+enum CensusKind {
+    CENSUS_BLOCK = 0, // still lifes
+    CENSUS_BEEHIVE = 1,
+    CENSUS_LOAF = 2,
+    CENSUS_BOAT = 3,
+    CENSUS_TUB = 4,
+    CENSUS_POND = 5,
+    CENSUS_SHIP = 6,
+    CENSUS_BLINKER = 7, // oscillators
+    CENSUS_TOAD = 8,
+    CENSUS_BEACON = 9,
+    CENSUS_GLIDER = 10, // spaceships
+    CENSUS_LWSS = 11,
+    CENSUS_OTHER = 12, // everything else, including objects closer than CENSUS_DISTANCE to each other
+    CENSUS_KIND_COUNT = 13
+};
+
+const char* censusKindName(int kind);
+
+/**
+ * The census log of the main process, one line per census with the number of objects of every kind
+ *
+ * @param file The csv file
+ * @param interval The generations between two censuses
+ * @param next_generation The generation of the next census to receive
+ * @param total_iterations The last generation
+ * @param world_size The total number of processes
+ * @param censuses The number of lines written
+ * @param merge_time Time the main process spent merging the objects that cross the rows of two workers
+ */
+struct CensusLog {
+    FILE* file;
+    int interval;
+    int next_generation;
+    int total_iterations;
+    int world_size;
+    int censuses;
+    double merge_time;
+};
+typedef struct CensusLog CensusLog;
+
+/**
+ * Creates the csv file and writes its header. There is a census of generation 0 and of every interval generations after it
+ */
+void openCensusLog(CensusLog* log, const char* file_name, int interval, int total_iterations, int world_size);
+
+/**
+ * Receives the censuses of the workers up to and including the generation and writes them to the log.
+ * The main process calls it before it receives a region or the grid of the same generation
+ */
+void receiveCensuses(CensusLog* log, int generation);
+
+void closeCensusLog(CensusLog* log);
+
+/**
+ * Takes the census of the rows the worker updates (cfg.local_grid) and sends it to the main process: the live cells are
+ * labeled as objects of cells at most CENSUS_DISTANCE apart from runs of cells, the objects inside the rows are classified
+ * on the worker, the fragments near the rows of a neighbor are sent with the runs along the boundary and joined by the main process
+ *
+ * @param cfg The worker process Config
+ */
+void takeCensus(WorkerConfig cfg);
+
+/**
+ * Frees the buffers the censuses of the process keep from one to the next, closeCensusLog frees the ones of the main process
+ */
+void freeCensusBuffers(void);
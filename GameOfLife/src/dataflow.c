@@ -0,0 +1,374 @@
+#include "dataflow.h"
+
+#include <limits.h> // INT_MAX
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // strcmp, memcpy
+#include <time.h> // clock_gettime
+
+
+// tag of the dataflow halo messages, every generation of a side arrives in order
+#define DATAFLOW_TAG 1
+// how long the main thread sleeps between tests of its receives when no tile advanced
+#define DATAFLOW_POLL_NANOSECONDS 20000
+
+
+int parseSchedule(const char* name) {
+    if (strcmp(name, "lockstep") == 0) {
+        return SCHEDULE_LOCKSTEP;
+    } else if (strcmp(name, "dataflow") == 0) {
+        return SCHEDULE_DATAFLOW;
+    }
+    return -1;
+}
+
+const char* scheduleName(int schedule) {
+    switch (schedule) {
+        case SCHEDULE_LOCKSTEP: return "lockstep";
+        case SCHEDULE_DATAFLOW: return "dataflow";
+        default: return "unknown";
+    }
+}
+
+
+void runLockstep(WorkerConfig* cfg, HaloExchange* halo, const KernelChoice* kernel, LargerThanLife* ltl, PerfCounters* counters, double* update_time, double* halo_time) {
+    for (int i = 0; i < cfg->total_iterations; i++) {
+        double phase_start = MPI_Wtime();
+        startCounterPhase(counters, COUNTER_PHASE_UPDATE);
+        if (kernel != NULL) {
+            updateGridWithKernel(kernel, *cfg);
+        } else {
+            updateGridLargerThanLife(ltl, *cfg);
+        }
+        swapGrids(cfg);
+        stopCounterPhase(counters);
+        double phase_mid = MPI_Wtime();
+        startCounterPhase(counters, COUNTER_PHASE_HALO);
+        exchangeHaloRows(halo, *cfg);
+        stopCounterPhase(counters);
+        *update_time += phase_mid - phase_start;
+        *halo_time += MPI_Wtime() - phase_mid;
+    }
+}
+
+
+/**
+ * The dependency graph of one worker. Node 0 is the lower ghost rows, nodes 1 to tile_count the tiles
+ * and node tile_count + 1 the upper ghost rows. Missing ghost rows are at generation INT_MAX, they never hold a tile back.
+ * Everything below the lock is shared between the threads
+ */
+struct Dataflow {
+    WorkerConfig cfg;
+    const KernelChoice* kernel;
+    unsigned char** grids[2]; // generation g of every node is in grids[g % 2]
+    int tile_count;
+    int* first_row; // per node, only set for the tiles
+    int* last_row;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready; // a tile was queued or all tiles are done
+    pthread_cond_t border_changed; // a tile next to the ghost rows advanced, the main thread has messages to send
+    int* generation;
+    bool* queued; // the tile is in the queue or running
+    int* queue; // ring of tile_count entries, a tile is in it at most once
+    int queue_head;
+    int queue_size;
+    int* tiles_at; // number of tiles per generation, to track the slowest one
+    int min_generation;
+    int max_lead;
+    int finished; // tiles at the last generation
+    int border_events;
+    long long idle_waits;
+};
+typedef struct Dataflow Dataflow;
+
+
+static bool isReady(const Dataflow* df, int node) {
+    if (node < 1 || node > df->tile_count || df->queued[node]) {
+        return false;
+    }
+    int generation = df->generation[node];
+    return generation < df->cfg.total_iterations && df->generation[node - 1] >= generation && df->generation[node + 1] >= generation;
+}
+
+/**
+ * Queues the node if it is a tile that can advance, needs the lock
+ */
+static void enqueueIfReady(Dataflow* df, int node) {
+    if (!isReady(df, node)) {
+        return;
+    }
+    df->queued[node] = true;
+    df->queue[(df->queue_head + df->queue_size) % df->tile_count] = node;
+    df->queue_size++;
+    pthread_cond_signal(&df->work_ready);
+}
+
+
+static void updateTile(const Dataflow* df, int tile, int generation, LargerThanLife* ltl) {
+    WorkerConfig cfg = df->cfg;
+    cfg.local_grid = df->grids[generation % 2];
+    cfg.next_grid = df->grids[(generation + 1) % 2];
+    cfg.update_start_row = df->first_row[tile];
+    cfg.update_end_row = df->last_row[tile];
+    cfg.update_row_count = cfg.update_end_row - cfg.update_start_row + 1;
+    if (df->kernel != NULL) {
+        updateGridWithKernel(df->kernel, cfg);
+    } else {
+        updateGridLargerThanLife(ltl, cfg);
+    }
+}
+
+/**
+ * Records that the tile reached the next generation and queues the tiles that waited for it, needs the lock
+ */
+static void advanceTile(Dataflow* df, int tile) {
+    int generation = ++df->generation[tile];
+    df->queued[tile] = false;
+    df->tiles_at[generation - 1]--;
+    df->tiles_at[generation]++;
+    while (df->tiles_at[df->min_generation] == 0) {
+        df->min_generation++;
+    }
+    if (generation - df->min_generation > df->max_lead) {
+        df->max_lead = generation - df->min_generation;
+    }
+    if (generation == df->cfg.total_iterations && ++df->finished == df->tile_count) {
+        pthread_cond_broadcast(&df->work_ready);
+    }
+    enqueueIfReady(df, tile - 1);
+    enqueueIfReady(df, tile);
+    enqueueIfReady(df, tile + 1);
+    if (tile == 1 || tile == df->tile_count || df->finished == df->tile_count) {
+        df->border_events++;
+        pthread_cond_signal(&df->border_changed);
+    }
+}
+
+
+static void* runTiles(void* arg) {
+    Dataflow* df = arg;
+    LargerThanLife ltl;
+    if (df->kernel == NULL) {
+        initLargerThanLife(&ltl, df->cfg); // the column sums are per thread
+    }
+    pthread_mutex_lock(&df->lock);
+    while (true) {
+        while (df->queue_size == 0 && df->finished < df->tile_count) {
+            df->idle_waits++;
+            pthread_cond_wait(&df->work_ready, &df->lock);
+        }
+        if (df->queue_size == 0) {
+            break;
+        }
+        int tile = df->queue[df->queue_head];
+        df->queue_head = (df->queue_head + 1) % df->tile_count;
+        df->queue_size--;
+        int generation = df->generation[tile];
+        pthread_mutex_unlock(&df->lock);
+
+        updateTile(df, tile, generation, &ltl);
+
+        pthread_mutex_lock(&df->lock);
+        advanceTile(df, tile);
+    }
+    pthread_mutex_unlock(&df->lock);
+    if (df->kernel == NULL) {
+        freeLargerThanLife(&ltl);
+    }
+    return NULL;
+}
+
+
+/**
+ * One side of the worker: the border rows it sends and the ghost rows it receives
+ */
+struct DataflowSide {
+    int rank; // world rank of the neighbor or MPI_PROC_NULL
+    int ghost_node;
+    int border_node;
+    int send_row;
+    int receive_row;
+    int sent_generation;
+    unsigned char* send_buffers[2]; // a copy per generation parity, the tile may overwrite its rows while the message is in flight
+    MPI_Request send_requests[2];
+    MPI_Request receive_request;
+};
+typedef struct DataflowSide DataflowSide;
+
+
+/**
+ * The main thread: sends every new generation of the border tiles and receives the ghost rows as soon as their buffer is free
+ */
+static void driveHalos(Dataflow* df, DataflowSide sides[2], HaloExchange* halo) {
+    const int last_generation = df->cfg.total_iterations;
+    const int cells = df->cfg.halo_depth * df->cfg.grid_width;
+    pthread_mutex_lock(&df->lock);
+    while (true) {
+        int border[2], ghost[2];
+        for (int s = 0; s < 2; s++) {
+            border[s] = df->generation[sides[s].border_node];
+            ghost[s] = df->generation[sides[s].ghost_node];
+        }
+        bool finished = df->finished == df->tile_count;
+        int events = df->border_events;
+        pthread_mutex_unlock(&df->lock);
+
+        // the ghost rows of the last generation are never read
+        bool receiving = false;
+        for (int s = 0; s < 2; s++) {
+            DataflowSide* side = &sides[s];
+            if (side->rank == MPI_PROC_NULL) {
+                continue;
+            }
+            while (side->sent_generation < border[s] && side->sent_generation < last_generation - 1) {
+                int generation = ++side->sent_generation;
+                int parity = generation % 2;
+                MPI_Wait(&side->send_requests[parity], MPI_STATUS_IGNORE);
+                memcpy(side->send_buffers[parity], df->grids[parity][side->send_row], cells);
+                MPI_Isend(side->send_buffers[parity], cells, MPI_CHAR, side->rank, DATAFLOW_TAG, MPI_COMM_WORLD, &side->send_requests[parity]);
+                halo->bytes_sent += cells;
+            }
+            // the next generation of the ghost rows goes into the buffer of the previous one, the tile next to them has to be done with it
+            if (side->receive_request == MPI_REQUEST_NULL && ghost[s] < last_generation - 1 && border[s] >= ghost[s]) {
+                MPI_Irecv(df->grids[(ghost[s] + 1) % 2][side->receive_row], cells, MPI_CHAR, side->rank, DATAFLOW_TAG, MPI_COMM_WORLD, &side->receive_request);
+            }
+            receiving |= side->receive_request != MPI_REQUEST_NULL;
+        }
+        if (finished) {
+            break;
+        }
+
+        bool arrived[2] = {false, false};
+        for (int s = 0; s < 2; s++) {
+            if (sides[s].receive_request != MPI_REQUEST_NULL) {
+                int done;
+                MPI_Test(&sides[s].receive_request, &done, MPI_STATUS_IGNORE);
+                arrived[s] = done;
+            }
+        }
+
+        pthread_mutex_lock(&df->lock);
+        for (int s = 0; s < 2; s++) {
+            if (arrived[s]) {
+                df->generation[sides[s].ghost_node]++;
+                enqueueIfReady(df, sides[s].border_node);
+            }
+        }
+        if (!arrived[0] && !arrived[1] && df->border_events == events) {
+            if (receiving) {
+                struct timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += DATAFLOW_POLL_NANOSECONDS;
+                if (deadline.tv_nsec >= 1000000000L) {
+                    deadline.tv_sec++;
+                    deadline.tv_nsec -= 1000000000L;
+                }
+                pthread_cond_timedwait(&df->border_changed, &df->lock, &deadline);
+            } else {
+                pthread_cond_wait(&df->border_changed, &df->lock);
+            }
+        }
+    }
+    for (int s = 0; s < 2; s++) {
+        MPI_Waitall(2, sides[s].send_requests, MPI_STATUSES_IGNORE);
+    }
+}
+
+
+void runDataflow(WorkerConfig* cfg, HaloExchange* halo, const KernelChoice* kernel, int threads, DataflowStats* stats) {
+    Dataflow df = {.cfg = *cfg, .kernel = kernel, .grids = {cfg->local_grid, cfg->next_grid}};
+    // a tile reads only the rows of its direct neighbors, so it has at least halo_depth rows
+    int tile_rows = cfg->update_row_count / (4 * threads);
+    if (tile_rows < cfg->halo_depth) {
+        tile_rows = cfg->halo_depth;
+    }
+    if (tile_rows < 1) {
+        tile_rows = 1;
+    }
+    df.tile_count = cfg->update_row_count / tile_rows;
+    if (df.tile_count < 1) {
+        df.tile_count = 1;
+    }
+    int nodes = df.tile_count + 2;
+    df.first_row = malloc(nodes * sizeof(int));
+    df.last_row = malloc(nodes * sizeof(int));
+    df.generation = calloc(nodes, sizeof(int));
+    df.queued = calloc(nodes, sizeof(bool));
+    df.queue = malloc(df.tile_count * sizeof(int));
+    df.tiles_at = calloc(cfg->total_iterations + 1, sizeof(int));
+    if (df.first_row == NULL || df.last_row == NULL || df.generation == NULL || df.queued == NULL || df.queue == NULL || df.tiles_at == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the tiles\n");
+        exit(1);
+    }
+    for (int tile = 1; tile <= df.tile_count; tile++) {
+        df.first_row[tile] = cfg->update_start_row + (tile - 1) * tile_rows;
+        df.last_row[tile] = tile == df.tile_count ? cfg->update_end_row : df.first_row[tile] + tile_rows - 1;
+    }
+    df.tiles_at[0] = df.tile_count;
+
+    DataflowSide sides[2] = {
+        {.rank = halo->lower_rank, .ghost_node = 0, .border_node = 1, .send_row = cfg->update_start_row, .receive_row = 0},
+        {.rank = halo->upper_rank, .ghost_node = df.tile_count + 1, .border_node = df.tile_count,
+            .send_row = cfg->update_end_row - cfg->halo_depth + 1, .receive_row = cfg->update_end_row + 1}
+    };
+    for (int s = 0; s < 2; s++) {
+        if (sides[s].rank == MPI_PROC_NULL) {
+            df.generation[sides[s].ghost_node] = INT_MAX;
+        }
+        for (int parity = 0; parity < 2; parity++) {
+            sides[s].send_buffers[parity] = malloc((size_t)cfg->halo_depth * cfg->grid_width);
+            sides[s].send_requests[parity] = MPI_REQUEST_NULL;
+            if (sides[s].send_buffers[parity] == NULL) {
+                fprintf(stderr, "Failed to allocate memory for the halo messages\n");
+                exit(1);
+            }
+        }
+        sides[s].sent_generation = 0; // generation 0 was exchanged before
+        sides[s].receive_request = MPI_REQUEST_NULL;
+    }
+
+    pthread_mutex_init(&df.lock, NULL);
+    pthread_cond_init(&df.work_ready, NULL);
+    pthread_cond_init(&df.border_changed, NULL);
+    for (int tile = 1; tile <= df.tile_count; tile++) {
+        enqueueIfReady(&df, tile);
+    }
+    pthread_t pool[threads];
+    for (int t = 0; t < threads; t++) {
+        if (pthread_create(&pool[t], NULL, runTiles, &df) != 0) {
+            fprintf(stderr, "Failed to start the update threads\n");
+            exit(1);
+        }
+    }
+
+    driveHalos(&df, sides, halo);
+
+    for (int t = 0; t < threads; t++) {
+        pthread_join(pool[t], NULL);
+    }
+    pthread_cond_destroy(&df.border_changed);
+    pthread_cond_destroy(&df.work_ready);
+    pthread_mutex_destroy(&df.lock);
+
+    // every tile is at the last generation, in the same buffer the lockstep loop ends in
+    if (cfg->total_iterations % 2 == 1) {
+        swapGrids(cfg);
+    }
+    stats->tile_count = df.tile_count;
+    stats->tile_rows = tile_rows;
+    stats->max_lead = df.max_lead;
+    stats->idle_waits = df.idle_waits;
+
+    for (int s = 0; s < 2; s++) {
+        free(sides[s].send_buffers[0]);
+        free(sides[s].send_buffers[1]);
+    }
+    free(df.first_row);
+    free(df.last_row);
+    free(df.generation);
+    free(df.queued);
+    free(df.queue);
+    free(df.tiles_at);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <mpi.h>
+#include <stdbool.h>
+
+#include "game_of_life_mpi.h"
+#include "halo_exchange.h"
+#include "kernel_registry.h"
+#include "larger_than_life.h"
+#include "perf_counters.h"
+
+/**
+ * How a worker advances its grid
+ */
+enum Schedule {
+    SCHEDULE_LOCKSTEP = 0, // update all rows, then exchange the halo, every generation
+    SCHEDULE_DATAFLOW = 1  // row band tiles advance on their own as soon as their neighbors allow it (runDataflow)
+};
+
+int parseSchedule(const char* name);
+const char* scheduleName(int schedule);
+
+/**
+ * Advances the grid by cfg->total_iterations generations: update all rows, swap the buffers and exchange the halo, every generation
+ *
+ * @param cfg The worker process Config, local_grid holds the last generation afterwards
+ * @param halo The halo exchange
+ * @param kernel The update kernel for Conway's rule, NULL to update with the Larger than Life rule of cfg
+ * @param ltl The workspace of the Larger than Life update, unused with a kernel
+ * @param counters The update and the exchange are counted as their phases
+ * @param update_time The time of the updates is added to it
+ * @param halo_time The time of the exchanges is added to it
+ */
+void runLockstep(WorkerConfig* cfg, HaloExchange* halo, const KernelChoice* kernel, LargerThanLife* ltl, PerfCounters* counters, double* update_time, double* halo_time);
+
+/**
+ * What a dataflow run did, for the timing output of the worker
+ *
+ * @param tile_count The number of row band tiles
+ * @param tile_rows The number of rows of a tile, the last one can have more
+ * @param max_lead The most generations the fastest tile was ahead of the slowest one
+ * @param idle_waits How often a thread found no tile to run
+ */
+struct DataflowStats {
+    int tile_count;
+    int tile_rows;
+    int max_lead;
+    long long idle_waits;
+};
+typedef struct DataflowStats DataflowStats;
+
+/**
+ * Advances the grid by cfg->total_iterations generations without a global step. The updated rows are split into
+ * row band tiles of at least halo_depth rows, and every tile has its own generation. A pool of threads runs any tile
+ * whose neighbors are at least at its generation. The ghost rows are two more tiles of the same graph: their generation
+ * advances when the border rows of the neighbor worker arrive, so one side of the grid keeps computing while the other
+ * waits for the network. The calling thread sends and receives all messages (MPI_THREAD_FUNNELED).
+ *
+ * Two buffers are enough: neighboring tiles are at most one generation apart, so a tile at generation g finds
+ * generation g of its neighbors in buffer g % 2.
+ * The ghost rows have to be filled for generation 0 and the halo backend must not alias them (no HALO_SHARED).
+ * Afterwards cfg->local_grid holds the last generation like after the lockstep loop
+ *
+ * @param cfg The worker process Config
+ * @param halo The halo exchange, only its grid buffers and neighbors are used, bytes_sent is increased
+ * @param kernel The update kernel for Conway's rule, NULL to update with the Larger than Life rule of cfg
+ * @param threads The number of threads that update tiles
+ * @param stats What the run did
+ */
+void runDataflow(WorkerConfig* cfg, HaloExchange* halo, const KernelChoice* kernel, int threads, DataflowStats* stats);
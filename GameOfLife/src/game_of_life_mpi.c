@@ -2,16 +2,31 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // memset
 
+#include "halo_codec.h"
+#include "kernel_registry.h"
+#include "memory_placement.h"
+#include "pattern_loader.h"
 #include "utils.h"
 #include "utils_grid.h"
 
 MPI_Datatype workerConfigType;
 
+// number of transmitted fields of WorkerConfig, all of them are int except the rule, the region and the two paths
+#define WORKER_CONFIG_FIELD_COUNT 33
+// tag of the region parts, the workers send them to the main process while it may wait for other messages
+#define REGION_TAG 2
+
 void createWorkerConfigMPIType(MPI_Datatype *newtype) {
-    int blocklengths[9] = {1, 1, 1, 1, 1, 1, 1, 1, 1};
-    MPI_Datatype types[9] = {MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT, MPI_INT};
-    MPI_Aint displacements[9];
+    int blocklengths[WORKER_CONFIG_FIELD_COUNT];
+    MPI_Datatype types[WORKER_CONFIG_FIELD_COUNT];
+    MPI_Aint displacements[WORKER_CONFIG_FIELD_COUNT];
+    for (int i = 0; i < WORKER_CONFIG_FIELD_COUNT; i++) {
+        blocklengths[i] = 1;
+        types[i] = MPI_INT;
+    }
     
     WorkerConfig temp;
     MPI_Aint base_address;
@@ -27,18 +42,48 @@ void createWorkerConfigMPIType(MPI_Datatype *newtype) {
     MPI_Get_address(&temp.update_start_row, &displacements[6]);
     MPI_Get_address(&temp.update_end_row, &displacements[7]);
     MPI_Get_address(&temp.update_row_count, &displacements[8]);
+    MPI_Get_address(&temp.halo_backend, &displacements[9]);
+    MPI_Get_address(&temp.halo_encoding, &displacements[10]);
+    MPI_Get_address(&temp.pack_transfers, &displacements[11]);
+    MPI_Get_address(&temp.pattern_offset_y, &displacements[12]);
+    MPI_Get_address(&temp.pattern_offset_x, &displacements[13]);
+    MPI_Get_address(&temp.kernel, &displacements[14]);
+    MPI_Get_address(&temp.page_mode, &displacements[15]);
+    MPI_Get_address(&temp.pin, &displacements[16]);
+    MPI_Get_address(&temp.counters, &displacements[17]);
+    MPI_Get_address(&temp.halo_depth, &displacements[18]);
+    MPI_Get_address(&temp.rule, &displacements[19]);
+    blocklengths[19] = LIFE_RULE_FIELD_COUNT; // only int fields
+    MPI_Get_address(&temp.pattern_file, &displacements[20]);
+    blocklengths[20] = PATTERN_PATH_LENGTH;
+    types[20] = MPI_CHAR;
+    MPI_Get_address(&temp.dimensions, &displacements[21]);
+    MPI_Get_address(&temp.seed, &displacements[22]);
+    MPI_Get_address(&temp.schedule, &displacements[23]);
+    MPI_Get_address(&temp.threads, &displacements[24]);
+    MPI_Get_address(&temp.universe, &displacements[25]);
+    MPI_Get_address(&temp.serve, &displacements[26]);
+    MPI_Get_address(&temp.region, &displacements[27]);
+    blocklengths[27] = GRID_REGION_FIELD_COUNT; // only int fields
+    MPI_Get_address(&temp.history_interval, &displacements[28]);
+    MPI_Get_address(&temp.replay_generation, &displacements[29]);
+    MPI_Get_address(&temp.fuse, &displacements[30]);
+    MPI_Get_address(&temp.out_of_core_dir, &displacements[31]);
+    blocklengths[31] = PATTERN_PATH_LENGTH;
+    types[31] = MPI_CHAR;
+    MPI_Get_address(&temp.census_interval, &displacements[32]);
 
     // Korrektur der Displacements
-    for (int i = 0; i < 9; i++) {
+    for (int i = 0; i < WORKER_CONFIG_FIELD_COUNT; i++) {
         displacements[i] -= base_address;
     }
 
-    MPI_Type_create_struct(9, blocklengths, displacements, types, newtype);
+    MPI_Type_create_struct(WORKER_CONFIG_FIELD_COUNT, blocklengths, displacements, types, newtype);
     MPI_Type_commit(newtype);
 }
 
 
-WorkerConfig initWorkerConfig(int world_size, int world_rank, int row_index_main_grid, int num_rows, int grid_width, int start_row, int total_iterations) {
+WorkerConfig initWorkerConfig(int world_size, int world_rank, int row_index_main_grid, int num_rows, int grid_width, int start_row, int total_iterations, int halo_depth) {
     assert(grid_width > 0);
     assert(num_rows > 0);
     WorkerConfig cfg = {
@@ -51,18 +96,42 @@ WorkerConfig initWorkerConfig(int world_size, int world_rank, int row_index_main
         .update_start_row = -1,
         .update_end_row = -1,
         .update_row_count = -1,
+        .halo_depth = halo_depth,
+        .rule = conwayRule(),
+        .universe = 0, // UNIVERSE_DENSE
+        .dimensions = 2,
+        .seed = 0,
+        .halo_backend = 0, // HALO_ISEND
+        .halo_encoding = 0, // HALO_ENCODING_RAW
+        .pack_transfers = 0,
+        .kernel = UPDATE_KERNEL_AUTO,
+        .page_mode = PAGES_DEFAULT,
+        .pin = 0,
+        .counters = 0,
+        .schedule = 0, // SCHEDULE_LOCKSTEP
+        .threads = 1,
+        .region = {0, 0, 0, 0, 1, 0},
+        .history_interval = 0,
+        .replay_generation = -1,
+        .census_interval = 0,
+        .fuse = 1,
+        .out_of_core_dir = "",
+        .serve = 0,
+        .pattern_offset_y = 0,
+        .pattern_offset_x = 0,
+        .pattern_file = "",
         .start_row = start_row
     };
-    cfg.update_start_row = world_rank == 1 ? 0 : 1; // worldrank 1 means first worker
+    cfg.update_start_row = world_rank == 1 ? 0 : halo_depth; // worldrank 1 means first worker
 
-    // minus 1 because its 0 indexed and minus 1 because the last row is not updated if its not the last rank
-    cfg.update_end_row = world_rank == world_size - 1 ?  num_rows - 1 : num_rows - 1 - 1; 
+    // minus 1 because its 0 indexed and minus halo_depth because the ghost rows are not updated if its not the last rank
+    cfg.update_end_row = world_rank == world_size - 1 ?  num_rows - 1 : num_rows - 1 - halo_depth; 
     cfg.update_row_count = cfg.update_end_row - cfg.update_start_row + 1;
     return cfg;
 }
 
 
-void distributeAndSendConfig(int world_size, int height, int width, int total_iterations, WorkerConfig* workerConfigs){
+void distributeAndSendConfig(int world_size, const GameConfig* game_cfg, WorkerConfig* workerConfigs){
     /*
     20 / 4 = 5
     start = rank * 5
@@ -73,9 +142,17 @@ void distributeAndSendConfig(int world_size, int height, int width, int total_it
     fourth = 15 - 19
     */
 
+    int height = game_cfg->height;
+    int width = game_cfg->width;
     int worker_amount = world_size - 1;
     int rowsPerProcess = height / worker_amount;
     int remainder = height % worker_amount;
+    // the ghost rows of a worker have to come from its direct neighbors, an out-of-core sweep needs them for all its generations
+    int halo_depth = game_cfg->rule.radius * (game_cfg->out_of_core != NULL ? game_cfg->fuse : 1);
+    if (game_cfg->dimensions == 2 && game_cfg->universe == 0 && worker_amount > 1 && rowsPerProcess < halo_depth) {
+        fprintf(stderr, "Error: every worker needs at least %d rows for %d ghost rows, but gets %d. Use fewer processes\n", halo_depth, halo_depth, rowsPerProcess);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
     // Distribute the grid to all processes, including itself
     for (int rank = 1; rank < world_size; rank++) { // iterate over all other processes
         
@@ -86,12 +163,39 @@ void distributeAndSendConfig(int world_size, int height, int width, int total_it
 
         int row_index_main_grid = start_row;
 
-        //send one line more to each process, therefor they are able to update the border
-        start_row = max(start_row - 1, 0);
-        end_row = min(end_row + 1, height - 1);
+        //send halo_depth lines more to each process, therefor they are able to update the border
+        start_row = max(start_row - halo_depth, 0);
+        end_row = min(end_row + halo_depth, height - 1);
         
         int num_rows = end_row - start_row + 1;
-        WorkerConfig cfg = initWorkerConfig(world_size, rank, row_index_main_grid, num_rows, width, start_row, total_iterations);
+        WorkerConfig cfg = initWorkerConfig(world_size, rank, row_index_main_grid, num_rows, width, start_row, game_cfg->total_iterations, halo_depth);
+        cfg.rule = game_cfg->rule;
+        cfg.universe = game_cfg->universe;
+        cfg.dimensions = game_cfg->dimensions;
+        cfg.seed = game_cfg->seed;
+        cfg.halo_backend = game_cfg->halo_backend;
+        cfg.halo_encoding = game_cfg->halo_encoding;
+        cfg.pack_transfers = game_cfg->pack_transfers;
+        cfg.kernel = game_cfg->kernel;
+        cfg.page_mode = game_cfg->page_mode;
+        cfg.pin = game_cfg->pin;
+        cfg.counters = game_cfg->counters;
+        cfg.schedule = game_cfg->schedule;
+        cfg.threads = game_cfg->threads;
+        cfg.region = game_cfg->region;
+        cfg.history_interval = game_cfg->history;
+        cfg.replay_generation = game_cfg->replay;
+        cfg.census_interval = game_cfg->census;
+        cfg.serve = game_cfg->serve != NULL;
+        if (game_cfg->out_of_core != NULL) {
+            snprintf(cfg.out_of_core_dir, PATTERN_PATH_LENGTH, "%s", game_cfg->out_of_core);
+            cfg.fuse = game_cfg->fuse;
+        }
+        if (game_cfg->pattern_file != NULL) {
+            snprintf(cfg.pattern_file, PATTERN_PATH_LENGTH, "%s", game_cfg->pattern_file);
+            cfg.pattern_offset_y = game_cfg->pattern_offset_y;
+            cfg.pattern_offset_x = game_cfg->pattern_offset_x;
+        }
         workerConfigs[idx] = cfg;
         // send the config to the worker
         //printf("main -> %d: Sending config\n", rank);
@@ -122,14 +226,63 @@ WorkerConfig receiveWorkerConfig() {
 }
 
 
-void receiveInitialGrid(WorkerConfig* cfg) {
-    // printf("Rank %d: receiving %d rows\n", cfg->world_rank, cfg->num_rows);
-    cfg->local_grid = createGrid(cfg->num_rows, cfg->grid_width);
-    for (int i = 0; i < cfg->num_rows; i++) {
-        //printf("Rank %d: Receiving row %d\n", world_rank, i);
-        MPI_Recv(cfg->local_grid[i], cfg->grid_width, MPI_CHAR, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+void loadInitialGrid(WorkerConfig* cfg) {
+    // every worker parses only the rows it updates, the ghost rows are filled by the first halo exchange
+    Pattern pattern;
+    int error = openPattern(cfg->pattern_file, &pattern);
+    if (error != PATTERN_OK) {
+        fprintf(stderr, "Error: worker %d cannot load the pattern %s: %s\n", cfg->world_rank, cfg->pattern_file, patternErrorName(error));
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    for (int i = cfg->update_start_row; i <= cfg->update_end_row; i++) {
+        memset(cfg->local_grid[i], 0, cfg->grid_width);
     }
+    placePatternRows(&pattern, cfg->pattern_offset_y, cfg->pattern_offset_x, cfg->row_index_main_grid, cfg->update_row_count,
+        &cfg->local_grid[cfg->update_start_row], cfg->grid_width);
+    closePattern(&pattern);
+}
+
 
+void seedInitialGrid(WorkerConfig* cfg, float density) {
+    for (int i = 0; i < cfg->update_row_count; i++) {
+        long long first_cell = (long long)(cfg->row_index_main_grid + i) * cfg->grid_width;
+        unsigned char* row = cfg->local_grid[cfg->update_start_row + i];
+        for (int j = 0; j < cfg->grid_width; j++) {
+            row[j] = hashedRandomCell(cfg->seed, first_cell + j, density);
+        }
+    }
+}
+
+
+/**
+ * One row of the grid, either one byte or one bit per cell
+ */
+static MPI_Datatype createRowType(int width, bool pack) {
+    MPI_Datatype row_type;
+    MPI_Type_contiguous(pack ? packedSize(width) : width, MPI_CHAR, &row_type);
+    MPI_Type_commit(&row_type);
+    return row_type;
+}
+
+
+void receiveInitialGrid(WorkerConfig* cfg) {
+    // the local grid is allocated by initHaloExchange, only the rows this worker updates are received.
+    // The ghost rows are filled by the first halo exchange
+    MPI_Datatype row_type = createRowType(cfg->grid_width, cfg->pack_transfers);
+    unsigned char* first_row = cfg->local_grid[cfg->update_start_row];
+
+    if (cfg->pack_transfers) {
+        int row_size = packedSize(cfg->grid_width);
+        unsigned char* packed = createGridSingleBlock(cfg->update_row_count, row_size);
+        MPI_Scatterv(NULL, NULL, NULL, row_type, packed, cfg->update_row_count, row_type, 0, MPI_COMM_WORLD);
+        for (int i = 0; i < cfg->update_row_count; i++) {
+            unpackCells(packed + (size_t)i * row_size, cfg->grid_width, cfg->local_grid[cfg->update_start_row + i]);
+        }
+        free(packed);
+    } else {
+        MPI_Scatterv(NULL, NULL, NULL, row_type, first_row, cfg->update_row_count, row_type, 0, MPI_COMM_WORLD);
+    }
+    MPI_Type_free(&row_type);
 }
 
 
@@ -137,7 +290,6 @@ void updateGridWithLimit(WorkerConfig cfg) {
     assert(cfg.update_start_row >= 0);
     assert(cfg.update_end_row > 0);
 
-    // First pass: Determine the next state for each cell
     // end row is inclusive
     for (int i = cfg.update_start_row; i <= cfg.update_end_row; i++) {
         for (int j = 0; j < cfg.grid_width; j++) {
@@ -149,34 +301,26 @@ void updateGridWithLimit(WorkerConfig cfg) {
                     int ni = i + y;
                     int nj = j + x;
                     if (ni >= 0 && ni < cfg.num_rows && nj >= 0 && nj < cfg.grid_width) {
-                        // cells are either 
-                        // 0b0 or 0b1 with bitshift we extract the one and add it to live Neighbors
-                        liveNeighbors += cfg.local_grid[ni][nj] & 1;
+                        liveNeighbors += cfg.local_grid[ni][nj];
                     }
                 }
             }
 
-            // Apply the Game of Life rules using the additional bits for the next state
-            if (cfg.local_grid[i][j] & 1) { // Currently alive, correctly check using & 1
-                if (liveNeighbors == 2 || liveNeighbors == 3) { // otherwise over or under population death
-                    // a cell is alive 'x1' and next round it needs to live set 2nd bit to 1 '11'
-                    cfg.local_grid[i][j] |= 2; // Set the second bit to stay alive in the next state
-                }
-            } else { // Currently dead
-                if (liveNeighbors == 3) {
-                    // a cell is dead 'x0' and next round it needs to be born set 2nd bit to 1 -> '10'
-                    cfg.local_grid[i][j] |= 2; // Dead cell becoming alive, set the second bit
-                }
+            // Apply the Game of Life rules, the current generation stays untouched so no second pass is needed
+            if (cfg.local_grid[i][j]) {
+                cfg.next_grid[i][j] = liveNeighbors == 2 || liveNeighbors == 3; // otherwise over or under population death
+            } else {
+                cfg.next_grid[i][j] = liveNeighbors == 3;
             }
         }
     }
-    
-    // Second pass: Update the grid to the next state
-    for (int i = cfg.update_start_row; i <= cfg.update_end_row; i++) {
-        for (int j = 0; j < cfg.grid_width; j++) {
-            cfg.local_grid[i][j] >>= 1; // Shift to the right to get the next state
-        }
-    }
+}
+
+
+void swapGrids(WorkerConfig* cfg) {
+    unsigned char** current = cfg->local_grid;
+    cfg->local_grid = cfg->next_grid;
+    cfg->next_grid = current;
 }
 
 
@@ -188,6 +332,8 @@ void sendandReceiveUpdatedGridRows(WorkerConfig cfg) {
     int request_count = 0;
 
     // lower upper in terms of index 0 is the lowest index and upper is a higher index
+    // the halo_depth border rows are contiguous and go in one message
+    int halo_cells = cfg.halo_depth * cfg.grid_width;
 
     int worker_idx = cfg.world_rank - 1;
     int worker_count = cfg.world_size - 1;
@@ -196,7 +342,7 @@ void sendandReceiveUpdatedGridRows(WorkerConfig cfg) {
         //printf("Rank %d: trying to send lower border to %d\n", cfg.world_rank, cfg.world_rank - 1);
         //printRow(cfg.world_rank, cfg.local_grid[cfg.update_start_row], cfg.grid_width);
 
-        MPI_Isend(cfg.local_grid[cfg.update_start_row], cfg.grid_width, MPI_CHAR, cfg.world_rank - 1, 0, MPI_COMM_WORLD, &requests[request_count++]);
+        MPI_Isend(cfg.local_grid[cfg.update_start_row], halo_cells, MPI_CHAR, cfg.world_rank - 1, 0, MPI_COMM_WORLD, &requests[request_count++]);
         //printf("Rank %d: Sent lower border to %d\n", cfg.world_rank, cfg.world_rank - 1);
     }
     //printf("Rank %d: worker_idx %d, worldsize: %d\n", cfg.world_rank, worker_idx, cfg.world_size);
@@ -205,7 +351,7 @@ void sendandReceiveUpdatedGridRows(WorkerConfig cfg) {
         //printf("Rank %d: trying to send upper border to %d\n", cfg.world_rank, cfg.world_rank + 1);
         //printRow(cfg.world_rank, cfg.local_grid[cfg.update_end_row], cfg.grid_width);
 
-        MPI_Isend(cfg.local_grid[cfg.update_end_row], cfg.grid_width, MPI_CHAR, cfg.world_rank + 1, 0, MPI_COMM_WORLD, &requests[request_count++]);
+        MPI_Isend(cfg.local_grid[cfg.update_end_row - cfg.halo_depth + 1], halo_cells, MPI_CHAR, cfg.world_rank + 1, 0, MPI_COMM_WORLD, &requests[request_count++]);
         //printf("Rank %d: Sent upper border to %d\n", cfg.world_rank, cfg.world_rank + 1);   
     }
 
@@ -213,14 +359,14 @@ void sendandReceiveUpdatedGridRows(WorkerConfig cfg) {
     if(worker_idx > 0) {
         //receive borders from the lower neighbor
         //printf("Rank %d: trying to receive lower border from %d\n", cfg.world_rank, cfg.world_rank - 1);
-        MPI_Irecv(cfg.local_grid[0], cfg.grid_width, MPI_CHAR, cfg.world_rank - 1, 0, MPI_COMM_WORLD, &requests[request_count++]);
+        MPI_Irecv(cfg.local_grid[0], halo_cells, MPI_CHAR, cfg.world_rank - 1, 0, MPI_COMM_WORLD, &requests[request_count++]);
     }
 
     
     if(worker_idx < worker_count - 1) {
         //receive borders from the upper neighbor
         //printf("Rank %d: trying to receive upper border from %d\n", cfg.world_rank, cfg.world_rank + 1);
-        MPI_Irecv(cfg.local_grid[cfg.num_rows - 1], cfg.grid_width, MPI_CHAR, cfg.world_rank + 1, 0, MPI_COMM_WORLD, &requests[request_count++]);
+        MPI_Irecv(cfg.local_grid[cfg.update_end_row + 1], halo_cells, MPI_CHAR, cfg.world_rank + 1, 0, MPI_COMM_WORLD, &requests[request_count++]);
     }
 
     //printf("Rank %d waiting for %d non-blocking sends to complete\n", cfg.world_rank, request_count);
@@ -232,51 +378,175 @@ void sendandReceiveUpdatedGridRows(WorkerConfig cfg) {
 
 
 void sendGridToMain(WorkerConfig cfg) {
-    
-    // Send the updated grid to the main process;
-    //printf("Rank %d: Sending total of %d rows to main\n", cfg.world_rank, cfg.update_row_count);
+    // the update_end_row is inclusive, the rows are contiguous
+    MPI_Datatype row_type = createRowType(cfg.grid_width, cfg.pack_transfers);
+
+    if (cfg.pack_transfers) {
+        int row_size = packedSize(cfg.grid_width);
+        unsigned char* packed = createGridSingleBlock(cfg.update_row_count, row_size);
+        for (int i = 0; i < cfg.update_row_count; i++) {
+            packCells(cfg.local_grid[cfg.update_start_row + i], cfg.grid_width, packed + (size_t)i * row_size);
+        }
+        MPI_Gatherv(packed, cfg.update_row_count, row_type, NULL, NULL, NULL, row_type, 0, MPI_COMM_WORLD);
+        free(packed);
+    } else {
+        MPI_Gatherv(cfg.local_grid[cfg.update_start_row], cfg.update_row_count, row_type, NULL, NULL, NULL, row_type, 0, MPI_COMM_WORLD);
+    }
+    MPI_Type_free(&row_type);
+}
 
-    // the update_end_row is inclusive
-    for (int i = cfg.update_start_row; i <= cfg.update_end_row; i++) {
-        MPI_Send(cfg.local_grid[i], cfg.grid_width, MPI_CHAR, 0, 0, MPI_COMM_WORLD);
+
+/**
+ * Number of rows and first row in the main grid of every rank, the main process gets none
+ */
+static void fillRowCountsAndDisplacements(WorkerConfig* workerConfigs, int world_size, int* counts, int* displacements) {
+    counts[0] = 0;
+    displacements[0] = 0;
+    for (int rank = 1; rank < world_size; rank++) {
+        counts[rank] = workerConfigs[rank - 1].update_row_count;
+        displacements[rank] = workerConfigs[rank - 1].row_index_main_grid;
     }
 }
 
 
-void sendGridPartsToWorkers(unsigned char** grid, WorkerConfig* workerConfigs, int worker_count) {
-    //printf("Main: Sending total grid to workers\n");
+void sendGridPartsToWorkers(unsigned char** grid, WorkerConfig* workerConfigs, int height, int width, int world_size, bool pack) {
+    int counts[world_size];
+    int displacements[world_size];
+    fillRowCountsAndDisplacements(workerConfigs, world_size, counts, displacements);
+    MPI_Datatype row_type = createRowType(width, pack);
+
+    if (pack) {
+        int row_size = packedSize(width);
+        unsigned char* packed = createGridSingleBlock(height, row_size);
+        for (int i = 0; i < height; i++) {
+            packCells(grid[i], width, packed + (size_t)i * row_size);
+        }
+        MPI_Scatterv(packed, counts, displacements, row_type, NULL, 0, row_type, 0, MPI_COMM_WORLD);
+        free(packed);
+    } else {
+        MPI_Scatterv(grid[0], counts, displacements, row_type, NULL, 0, row_type, 0, MPI_COMM_WORLD);
+    }
+    MPI_Type_free(&row_type);
+}
 
-    for (int worker_idx = 0; worker_idx < worker_count; worker_idx++) {
-        WorkerConfig* cfg = &workerConfigs[worker_idx];
-        //printf("Main: Sending %d rows to %d\n", cfg->num_rows, cfg->world_rank);
-        for(int i = 0; i < cfg->num_rows; i++) {
-            //printf("Main: Sending row %d to %d\n", cfg->row_index_main_grid + i, cfg->world_rank);
 
-            MPI_Send(grid[cfg->start_row + i], cfg->grid_width, MPI_CHAR, cfg->world_rank, 0, MPI_COMM_WORLD);
+void receiveGridParts(WorkerConfig* workerConfigs, unsigned char** grid, int height, int width, int world_size, bool pack) {
+    printf("Main: waiting to receive total grid from workers\n");
+    int counts[world_size];
+    int displacements[world_size];
+    fillRowCountsAndDisplacements(workerConfigs, world_size, counts, displacements);
+    MPI_Datatype row_type = createRowType(width, pack);
+
+    if (pack) {
+        int row_size = packedSize(width);
+        unsigned char* packed = createGridSingleBlock(height, row_size);
+        MPI_Gatherv(NULL, 0, row_type, packed, counts, displacements, row_type, 0, MPI_COMM_WORLD);
+        for (int i = 0; i < height; i++) {
+            unpackCells(packed + (size_t)i * row_size, width, grid[i]);
         }
+        free(packed);
+    } else {
+        MPI_Gatherv(NULL, 0, row_type, grid[0], counts, displacements, row_type, 0, MPI_COMM_WORLD);
     }
-    //printf("Main: Sent total grid\n");
+    MPI_Type_free(&row_type);
+}
+
 
+/**
+ * The rows of the downsampled region that contain main grid rows first_row to first_row + row_count - 1
+ *
+ * @return false if there are none
+ */
+static bool regionRowRange(const GridRegion* region, int first_row, int row_count, int* first, int* last) {
+    int start = max(first_row, region->row);
+    int end = min(first_row + row_count - 1, region->row + region->height - 1);
+    if (start > end) {
+        return false;
+    }
+    *first = (start - region->row) / region->step;
+    *last = (end - region->row) / region->step;
+    return true;
 }
 
 
-void receiveGridParts(WorkerConfig* workerConfigs, unsigned char** grid, int height, int width, int world_size) {
-    printf("Main: waiting to receive total grid from workers\n");
-    MPI_Request requests[height]; // send all grid rows
-    //printf("Main: waiting to receive a total of %d rows\n", height);
-    int request_count = 0;
-    for (int worker_idx = 1; worker_idx < world_size; worker_idx++) {
-        
-        WorkerConfig* cfg = &workerConfigs[worker_idx-1];
-        //printf("Main: waiting to receive %d rows from %d\n", cfg->update_row_count, worker_idx);
-        for(int i = 0; i < cfg->update_row_count; i++) {
-            //MPI_Recv(grid[cfg->row_index_main_grid + i], width, MPI_CHAR, worker_idx, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            //printf("Main: Received row %d from %d\n", cfg->row_index_main_grid + i, worker_idx);
-            MPI_Irecv(grid[cfg->row_index_main_grid + i], width, MPI_CHAR, worker_idx, 0, MPI_COMM_WORLD, &requests[request_count++]);
+bool ownsRegionRows(WorkerConfig cfg) {
+    int first, last;
+    return regionRowRange(&cfg.region, cfg.row_index_main_grid, cfg.update_row_count, &first, &last);
+}
+
+
+void sendRegionToMain(WorkerConfig cfg) {
+    const GridRegion* region = &cfg.region;
+    int first, last;
+    if (!regionRowRange(region, cfg.row_index_main_grid, cfg.update_row_count, &first, &last)) {
+        return;
+    }
+    int columns = regionColumns(region);
+    int rows = last - first + 1;
+    int row_size = cfg.pack_transfers ? packedSize(columns) : columns;
+    unsigned char* part = createGridSingleBlock(rows, row_size);
+    unsigned char* pixels = malloc(columns);
+    if (pixels == NULL) {
+        fprintf(stderr, "Failed to allocate memory for a region row\n");
+        exit(1);
+    }
+    int own_end = cfg.row_index_main_grid + cfg.update_row_count - 1;
+    int region_end = region->row + region->height - 1;
+    int column_end = region->column + region->width - 1;
+    for (int r = first; r <= last; r++) {
+        memset(pixels, 0, columns);
+        // only the rows of the block this worker owns, the next worker sends the others
+        int block_start = max(region->row + r * region->step, cfg.row_index_main_grid);
+        int block_end = min(min(region->row + (r + 1) * region->step - 1, region_end), own_end);
+        for (int y = block_start; y <= block_end; y++) {
+            const unsigned char* row = cfg.local_grid[y - cfg.row_index_main_grid + cfg.update_start_row];
+            for (int x = region->column; x <= column_end; x++) {
+                pixels[(x - region->column) / region->step] |= row[x];
+            }
+        }
+        unsigned char* out = part + (size_t)(r - first) * row_size;
+        if (cfg.pack_transfers) {
+            packCells(pixels, columns, out);
+        } else {
+            memcpy(out, pixels, columns);
         }
     }
-    //printf("Request count: %d height: %d\n", request_count, height);
-    MPI_Waitall(request_count, requests, MPI_STATUSES_IGNORE); // wait for all rows to be received
-    
-    //printf("Main: Received total grid\n");
-}
\ No newline at end of file
+    MPI_Send(part, rows * row_size, MPI_CHAR, 0, REGION_TAG, MPI_COMM_WORLD);
+    free(pixels);
+    free(part);
+}
+
+
+void receiveRegion(WorkerConfig* workerConfigs, int world_size, const GridRegion* region, bool pack, unsigned char** cells) {
+    int rows = regionRows(region);
+    int columns = regionColumns(region);
+    int row_size = pack ? packedSize(columns) : columns;
+    memset(cells[0], 0, (size_t)rows * columns);
+    // a worker sends at most all rows of the region
+    unsigned char* part = createGridSingleBlock(rows, row_size);
+    unsigned char* pixels = malloc(columns);
+    if (pixels == NULL) {
+        fprintf(stderr, "Failed to allocate memory for a region row\n");
+        exit(1);
+    }
+    for (int idx = 0; idx < world_size - 1; idx++) {
+        const WorkerConfig* worker = &workerConfigs[idx];
+        int first, last;
+        if (!regionRowRange(region, worker->row_index_main_grid, worker->update_row_count, &first, &last)) {
+            continue;
+        }
+        MPI_Recv(part, (last - first + 1) * row_size, MPI_CHAR, worker->world_rank, REGION_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        for (int r = first; r <= last; r++) {
+            const unsigned char* in = part + (size_t)(r - first) * row_size;
+            if (pack) {
+                unpackCells(in, columns, pixels);
+                in = pixels;
+            }
+            for (int c = 0; c < columns; c++) {
+                cells[r][c] |= in[c];
+            }
+        }
+    }
+    free(pixels);
+    free(part);
+}
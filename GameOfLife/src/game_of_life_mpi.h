@@ -3,16 +3,24 @@
 
 #include <mpi.h>
 
+#include "arg_parser.h"
+#include "life_rule.h"
+#include "pattern_loader.h"
+#include "region_query.h"
+
 /**
  * Data of the worker process
  * 
  * @param world_rank The rank of the worker
  * @param world_size The total number of processes
  * @param local_grid The local grid of the worker
+ * @param next_grid The second buffer the next generation is written to
  * @param grid_height The height of the grid
  * @param grid_width The width of the grid
  * @param update_start_row The first row to update
  * @param update_end_row The last row to update
+ * @param halo_depth The number of ghost rows, local_grid[0 .. halo_depth - 1] and local_grid[update_end_row + 1 .. num_rows - 1]
+ * @param rule The rule of the game
  */
 struct WorkerConfig {
     int world_size;
@@ -20,13 +28,42 @@ struct WorkerConfig {
     int total_iterations;
 
     int row_index_main_grid; // the row index in the main grid of the update_start_row
-    unsigned char** local_grid;
+    unsigned char** local_grid; // current generation
+    unsigned char** next_grid; // next generation, swapped with local_grid after every update, not sent
     int num_rows; //dynamic height of the grid, more than the update update_row_count
     int grid_width; // total width of the grid, stays the same for all workers
 
-    int update_start_row; // most of the time its 1 but if its the first rank it is 0
-    int update_end_row; // most of the time its height - 1 but if its the last rank it is height
+    int update_start_row; // most of the time its halo_depth but if its the first rank it is 0
+    int update_end_row; // most of the time its num_rows - 1 - halo_depth but if its the last rank it is num_rows - 1
     int update_row_count;
+    int halo_depth; // ghost rows on each side with a neighbor, the radius of the rule
+
+    LifeRule rule;
+    int universe; // UNIVERSE_SPARSE runs the tiles of sparse_universe.h, grid_width is the side of the random square
+    int dimensions; // 3 runs the cube of life3d.h, grid_width is its edge length and the row fields are unused
+    int seed; // seed of the random cube, every worker creates its own part
+
+    int halo_backend; // HaloBackend used for the per generation exchange
+    int halo_encoding; // HaloEncoding of the halo messages
+    int pack_transfers; // bit-pack the initial grid and the result
+    int kernel; // UpdateKernelId, UPDATE_KERNEL_AUTO benchmarks the kernels at startup
+    int page_mode; // PageMode of the grid buffers
+    int pin; // bind the worker to a CPU before the grid is allocated
+    int counters; // collect hardware counters per phase
+    int schedule; // Schedule of the generations
+    int threads; // threads that update tiles with SCHEDULE_DATAFLOW
+    GridRegion region; // the rectangle that is sent instead of the grid, height 0 sends the whole grid
+    int history_interval; // keyframe interval of the history of the worker, 0 records nothing
+    int replay_generation; // generation rebuilt from the history instead of the initial grid, -1 to run the game
+    int census_interval; // generations between two censuses of census.h, 0 takes none
+    int fuse; // generations per sweep of the out-of-core grid, the halo_depth is fuse x radius
+    char out_of_core_dir[PATTERN_PATH_LENGTH]; // directory of the partition files of out_of_core.h, empty keeps the grid in memory
+    int serve; // the worker keeps running the jobs of the server (server.h) until the main process stops it
+
+    // the workers load the initial grid themselves if a pattern file is given
+    int pattern_offset_y; // row of the main grid the pattern is placed at
+    int pattern_offset_x;
+    char pattern_file[PATTERN_PATH_LENGTH]; // empty if the main process sends a random grid
 
     //only used for sending the intital grid to the workers
     int start_row;  // the start row of the local grid in the main grid. The local grid is one larger than the grid thats getting updated
@@ -45,23 +82,22 @@ void createWorkerConfigMPIType(MPI_Datatype *newtype);
  * @param world_size The total number of processes
  * @param world_rank The rank of the worker
  * @param row_index_main_grid The row index in the main grid that will be send back to the main process
- * @param num_rows The number of rows to update
+ * @param num_rows The number of rows including the ghost rows
  * @param width The width of the grid
+ * @param halo_depth The number of ghost rows to each neighbor
  * @return The initialized worker process Config
  */
-WorkerConfig initWorkerConfig(int world_size, int world_rank, int row_index_main_grid, int num_rows, int grid_width, int start_row, int total_iterations);
+WorkerConfig initWorkerConfig(int world_size, int world_rank, int row_index_main_grid, int num_rows, int grid_width, int start_row, int total_iterations, int halo_depth);
 
 
 /**
  * Distributes the Config to all worker processes
  * 
  * @param world_size The total number of processes
- * @param grid The grid to distribute
- * @param height The height of the grid
- * @param width The width of the grid
+ * @param game_cfg The parsed game configuration (grid size, iterations and runtime options)
  * @param workerConfigs The worker process Configs
  */
-void distributeAndSendConfig(int world_size, int height, int width, int total_iterations, WorkerConfig* workerConfigs);
+void distributeAndSendConfig(int world_size, const GameConfig* game_cfg, WorkerConfig* workerConfigs);
 
 
 /**
@@ -73,27 +109,53 @@ WorkerConfig receiveWorkerConfig();
 
 
 /**
- * Receives the initial grid from the main process
+ * Receives the rows this worker updates from the main process with MPI_Scatterv into the already allocated local grid.
+ * The ghost rows are not received, a halo exchange has to fill them
  * 
  * @param cfg The worker process Config
  */
 void receiveInitialGrid(WorkerConfig* cfg);
 
 
+/**
+ * Loads the rows this worker updates from the pattern file (cfg->pattern_file) into the already allocated local grid,
+ * the rest of the grid is dead. The ghost rows are not loaded, a halo exchange has to fill them
+ * 
+ * @param cfg The worker process Config
+ */
+void loadInitialGrid(WorkerConfig* cfg);
+
+
+/**
+ * Fills the rows this worker updates with the random cells of cfg->seed, independent of the number of workers.
+ * The ghost rows are not filled, a halo exchange has to fill them
+ * 
+ * @param cfg The worker process Config
+ * @param density The share of alive cells
+ */
+void seedInitialGrid(WorkerConfig* cfg, float density);
+
+
 /**
  * Updates the grid with the Game of Life rules, but only for the specified rows
  * it doesnt update the border of the grid.
- * This is a variation of the single-core implementation 
+ * Reads the current generation from local_grid and writes the next one to next_grid,
+ * swapGrids makes it the current generation
  * 
- * @param grid The grid to update
- * @param height The height of the grid
- * @param width The width of the grid
- * @param update_min The first row to update
- * @param update_max The last row to update
+ * @param cfg The worker process Config
  */
 void updateGridWithLimit(WorkerConfig cfg);
 
 
+/**
+ * Swaps local_grid and next_grid after an update, the ghost rows of the new local_grid
+ * are outdated until the next halo exchange
+ * 
+ * @param cfg The worker process Config
+ */
+void swapGrids(WorkerConfig* cfg);
+
+
 /**
  * Sends the updated grid to the neighbor processes and receives the updated grid from the neighbor processes
  * 
@@ -103,31 +165,65 @@ void sendandReceiveUpdatedGridRows(WorkerConfig cfg);
 
 
 /**
- * Sends the grid to the main process from the worker process
+ * Sends the updated rows to the main process from the worker process with MPI_Gatherv
  * 
  * @param cfg The worker process Config
  
 */
 void sendGridToMain(WorkerConfig cfg);
 
+/**
+ * Sends the part of cfg.region in the rows this worker updates to the main process, downsampled by cfg.region.step
+ * and bit-packed with cfg.pack_transfers. A worker that owns no row of the region returns without sending
+ *
+ * @param cfg The worker process Config
+ */
+void sendRegionToMain(WorkerConfig cfg);
+
+/**
+ * Whether the worker updates a row of cfg.region
+ *
+ * @param cfg The worker process Config
+ */
+bool ownsRegionRows(WorkerConfig cfg);
+
+/**
+ * This is called by the main process 0. It receives the parts of the region from the workers that own its rows,
+ * point to point and in the order of the workers, the grid is never assembled. Rows of the downsampled region
+ * that span two workers get a part from both
+ *
+ * @param workerConfigs The worker process Configs
+ * @param world_size The total number of processes
+ * @param region The region, the same as in the configs of the workers
+ * @param pack The parts are sent with one bit per cell
+ * @param cells The contiguous region to receive into (createGridView), regionRows x regionColumns
+ */
+void receiveRegion(WorkerConfig* workerConfigs, int world_size, const GridRegion* region, bool pack, unsigned char** cells);
+
 /**
  * This is called by the main process 0. It receives the grid parts from all other worker processes
- * uses non blocking receive to receive the grid parts
+ * with one MPI_Gatherv, every worker sends its updated rows as one block
  *  
- * @param grid The grid to receive the parts into
+ * @param workerConfigs The worker process Configs
+ * @param grid The contiguous grid to receive the parts into (createGridView)
  * @param height The height of the grid
  * @param width The width of the grid
  * @param world_size The total number of processes
+ * @param pack The rows are sent with one bit per cell
  */
-void receiveGridParts(WorkerConfig* workerConfigs, unsigned char** grid, int height, int width, int world_size);
+void receiveGridParts(WorkerConfig* workerConfigs, unsigned char** grid, int height, int width, int world_size, bool pack);
 
 /**
  * This is called by the main process 0. It sends the grid parts to all worker processes
+ * with one MPI_Scatterv, every worker gets the rows it updates as one block
  * 
- * @param grid The grid to send the parts from
+ * @param grid The contiguous grid to send the parts from (createGridView)
  * @param workerConfigs The worker process Configs
- * @param worker_count The total number of worker processes
+ * @param height The height of the grid
+ * @param width The width of the grid
+ * @param world_size The total number of processes
+ * @param pack The rows are sent with one bit per cell
  */
-void sendGridPartsToWorkers(unsigned char** grid, WorkerConfig* workerConfigs, int worker_count);
+void sendGridPartsToWorkers(unsigned char** grid, WorkerConfig* workerConfigs, int height, int width, int world_size, bool pack);
 
 #endif
\ No newline at end of file
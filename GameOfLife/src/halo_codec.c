@@ -0,0 +1,235 @@
+#include "halo_codec.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h> // calloc, free, exit
+#include <string.h> // strcmp, memcpy, memset
+
+
+int parseHaloEncoding(const char* name) {
+    if (strcmp(name, "raw") == 0) {
+        return HALO_ENCODING_RAW;
+    } else if (strcmp(name, "packed") == 0) {
+        return HALO_ENCODING_PACKED;
+    } else if (strcmp(name, "adaptive") == 0) {
+        return HALO_ENCODING_ADAPTIVE;
+    }
+    return -1;
+}
+
+const char* haloEncodingName(int encoding) {
+    switch (encoding) {
+        case HALO_ENCODING_RAW: return "raw";
+        case HALO_ENCODING_PACKED: return "packed";
+        case HALO_ENCODING_ADAPTIVE: return "adaptive";
+        default: return "unknown";
+    }
+}
+
+
+int packedSize(int length) {
+    return (length + 7) / 8;
+}
+
+void packCells(const unsigned char* cells, int length, unsigned char* packed) {
+    int full_bytes = length / 8;
+    for (int b = 0; b < full_bytes; b++) {
+        const unsigned char* c = cells + b * 8;
+        packed[b] = (c[0] & 1) | (c[1] & 1) << 1 | (c[2] & 1) << 2 | (c[3] & 1) << 3
+                  | (c[4] & 1) << 4 | (c[5] & 1) << 5 | (c[6] & 1) << 6 | (c[7] & 1) << 7;
+    }
+    if (length % 8 != 0) {
+        unsigned char last = 0;
+        for (int i = full_bytes * 8; i < length; i++) {
+            last |= (cells[i] & 1) << (i % 8);
+        }
+        packed[full_bytes] = last;
+    }
+}
+
+void unpackCells(const unsigned char* packed, int length, unsigned char* cells) {
+    for (int i = 0; i < length; i++) {
+        cells[i] = (packed[i / 8] >> (i % 8)) & 1;
+    }
+}
+
+
+static int varintSize(unsigned int value) {
+    int size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static int writeVarint(unsigned int value, unsigned char* out, int capacity) {
+    int size = 0;
+    while (value >= 0x80) {
+        if (size >= capacity) return -1;
+        out[size++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    if (size >= capacity) return -1;
+    out[size++] = value;
+    return size;
+}
+
+static int readVarint(const unsigned char* in, int size, unsigned int* value) {
+    unsigned int result = 0;
+    int shift = 0;
+    int i = 0;
+    while (i < size) {
+        unsigned char byte = in[i++];
+        result |= (unsigned int)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) break;
+        shift += 7;
+    }
+    *value = result;
+    return i;
+}
+
+
+int encodeRuns(const unsigned char* cells, const unsigned char* reference, int length, unsigned char* out, int capacity) {
+    int size = 0;
+    unsigned char state = 0; // runs start with dead cells
+    unsigned int run = 0;
+    for (int i = 0; i < length; i++) {
+        unsigned char bit = (reference == NULL ? cells[i] : cells[i] ^ reference[i]) & 1;
+        if (bit != state) {
+            int written = writeVarint(run, out + size, capacity - size);
+            if (written < 0) return -1;
+            size += written;
+            state = bit;
+            run = 0;
+        }
+        run++;
+    }
+    int written = writeVarint(run, out + size, capacity - size);
+    if (written < 0) return -1;
+    return size + written;
+}
+
+void decodeRuns(const unsigned char* in, int size, const unsigned char* reference, int length, unsigned char* cells) {
+    int position = 0;
+    unsigned char state = 0;
+    int offset = 0;
+    while (offset < size) {
+        unsigned int run;
+        offset += readVarint(in + offset, size - offset, &run);
+        assert(position + (int)run <= length);
+        if (reference == NULL) {
+            memset(cells + position, state, run);
+        } else {
+            for (unsigned int i = 0; i < run; i++) {
+                cells[position + i] = (reference[position + i] ^ state) & 1;
+            }
+        }
+        position += run;
+        state ^= 1;
+    }
+    assert(position == length);
+}
+
+
+void initHaloCodec(HaloCodec* codec, int length) {
+    codec->length = length;
+    codec->capacity = 1 + packedSize(length); // the format byte and the largest payload
+    codec->last_sent = calloc(length, 1);
+    codec->last_received = calloc(length, 1);
+    codec->send_buffer = malloc(codec->capacity);
+    codec->recv_buffer = malloc(codec->capacity);
+    if (!codec->last_sent || !codec->last_received || !codec->send_buffer || !codec->recv_buffer) {
+        fprintf(stderr, "Failed to allocate memory for the halo codec\n");
+        exit(1);
+    }
+}
+
+void freeHaloCodec(HaloCodec* codec) {
+    free(codec->last_sent);
+    free(codec->last_received);
+    free(codec->send_buffer);
+    free(codec->recv_buffer);
+}
+
+
+/**
+ * Chooses the format from the density of the message: the number of run boundaries
+ * of the cells and of the changes estimates the size of the run encodings
+ */
+static int chooseHaloFormat(const HaloCodec* codec, const unsigned char* cells) {
+    int transitions = 0, delta_transitions = 0, changed = 0;
+    unsigned char previous = 0, previous_delta = 0;
+    for (int i = 0; i < codec->length; i++) {
+        unsigned char bit = cells[i] & 1;
+        unsigned char delta = bit ^ (codec->last_sent[i] & 1);
+        transitions += bit != previous;
+        delta_transitions += delta != previous_delta;
+        changed += delta;
+        previous = bit;
+        previous_delta = delta;
+    }
+    if (changed == 0) {
+        return HALO_FORMAT_UNCHANGED;
+    }
+
+    int runs_size = (transitions + 1) * varintSize(codec->length / (transitions + 1));
+    int delta_size = (delta_transitions + 1) * varintSize(codec->length / (delta_transitions + 1));
+    int packed_size = packedSize(codec->length);
+    if (delta_size <= runs_size && delta_size < packed_size) {
+        return HALO_FORMAT_DELTA_RUNS;
+    } else if (runs_size < packed_size) {
+        return HALO_FORMAT_RUNS;
+    }
+    return HALO_FORMAT_PACKED;
+}
+
+
+int encodeHaloMessage(HaloCodec* codec, const unsigned char* cells, int encoding) {
+    int format = encoding == HALO_ENCODING_ADAPTIVE ? chooseHaloFormat(codec, cells) : HALO_FORMAT_PACKED;
+    unsigned char* payload = codec->send_buffer + 1;
+    int payload_capacity = codec->capacity - 1;
+    int size = -1;
+
+    // the estimate of the run encodings can be too small, then they fall back to packed
+    if (format == HALO_FORMAT_UNCHANGED) {
+        size = 0;
+    } else if (format == HALO_FORMAT_DELTA_RUNS) {
+        size = encodeRuns(cells, codec->last_sent, codec->length, payload, payload_capacity);
+    } else if (format == HALO_FORMAT_RUNS) {
+        size = encodeRuns(cells, NULL, codec->length, payload, payload_capacity);
+    }
+    if (size < 0 || format == HALO_FORMAT_PACKED) {
+        format = HALO_FORMAT_PACKED;
+        packCells(cells, codec->length, payload);
+        size = packedSize(codec->length);
+    }
+
+    codec->send_buffer[0] = format;
+    memcpy(codec->last_sent, cells, codec->length);
+    return size + 1;
+}
+
+
+void decodeHaloMessage(HaloCodec* codec, int size, unsigned char* cells) {
+    assert(size >= 1);
+    const unsigned char* payload = codec->recv_buffer + 1;
+    switch (codec->recv_buffer[0]) {
+        case HALO_FORMAT_PACKED:
+            unpackCells(payload, codec->length, cells);
+            break;
+        case HALO_FORMAT_RUNS:
+            decodeRuns(payload, size - 1, NULL, codec->length, cells);
+            break;
+        case HALO_FORMAT_DELTA_RUNS:
+            decodeRuns(payload, size - 1, codec->last_received, codec->length, cells);
+            break;
+        case HALO_FORMAT_UNCHANGED:
+            memcpy(cells, codec->last_received, codec->length);
+            break;
+        default:
+            fprintf(stderr, "Unknown halo message format %d\n", codec->recv_buffer[0]);
+            exit(1);
+    }
+    memcpy(codec->last_received, cells, codec->length);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+/**
+ * Encoding of the halo messages, selected with --halo-encoding
+ */
+enum HaloEncoding {
+    HALO_ENCODING_RAW = 0,      // one byte per cell, the rows are sent as they are
+    HALO_ENCODING_PACKED = 1,   // 8 cells per byte
+    HALO_ENCODING_ADAPTIVE = 2  // the smallest of packed, runs, delta runs and unchanged per message
+};
+
+/**
+ * Format of one encoded message, stored in its first byte
+ */
+enum HaloFormat {
+    HALO_FORMAT_PACKED = 0,     // 8 cells per byte
+    HALO_FORMAT_RUNS = 1,       // alternating lengths of dead and alive runs as varints, starting with dead
+    HALO_FORMAT_DELTA_RUNS = 2, // runs of the cells that changed since the previous message
+    HALO_FORMAT_UNCHANGED = 3   // identical to the previous message, no payload
+};
+
+/**
+ * Encoder and decoder state of the messages between this worker and one neighbor.
+ * Both sides start with all cells dead, so the references stay in lockstep
+ *
+ * @param length The number of cells per message
+ * @param capacity The size of the message buffers in bytes
+ * @param last_sent The cells of the previous message to the neighbor
+ * @param last_received The cells of the previous message from the neighbor
+ */
+struct HaloCodec {
+    int length;
+    int capacity;
+    unsigned char* last_sent;
+    unsigned char* last_received;
+    unsigned char* send_buffer;
+    unsigned char* recv_buffer;
+};
+typedef struct HaloCodec HaloCodec;
+
+/**
+ * Parses the name of a halo encoding
+ *
+ * @param name Either "raw", "packed" or "adaptive"
+ * @return The HaloEncoding or -1 if the name is unknown
+ */
+int parseHaloEncoding(const char* name);
+
+const char* haloEncodingName(int encoding);
+
+/**
+ * Number of bytes needed to store length cells with 8 cells per byte
+ */
+int packedSize(int length);
+
+/**
+ * Stores the lowest bit of every cell, 8 cells per byte
+ *
+ * @param cells The cells to pack
+ * @param length The number of cells
+ * @param packed The output with at least packedSize(length) bytes
+ */
+void packCells(const unsigned char* cells, int length, unsigned char* packed);
+
+void unpackCells(const unsigned char* packed, int length, unsigned char* cells);
+
+/**
+ * Writes the lengths of the alternating dead and alive runs as varints, starting with a dead run.
+ * If reference is not NULL the runs of cells that differ from the reference are encoded instead
+ *
+ * @param cells The cells to encode
+ * @param reference The previous cells or NULL
+ * @param length The number of cells
+ * @param out The output buffer
+ * @param capacity The size of the output buffer
+ * @return The number of bytes written or -1 if the runs don't fit into capacity
+ */
+int encodeRuns(const unsigned char* cells, const unsigned char* reference, int length, unsigned char* out, int capacity);
+
+void decodeRuns(const unsigned char* in, int size, const unsigned char* reference, int length, unsigned char* cells);
+
+void initHaloCodec(HaloCodec* codec, int length);
+
+void freeHaloCodec(HaloCodec* codec);
+
+/**
+ * Encodes the cells into codec->send_buffer
+ *
+ * @param codec The state of the neighbor
+ * @param cells The border cells to send
+ * @param encoding HALO_ENCODING_PACKED or HALO_ENCODING_ADAPTIVE
+ * @return The size of the message in bytes
+ */
+int encodeHaloMessage(HaloCodec* codec, const unsigned char* cells, int encoding);
+
+/**
+ * Decodes the message in codec->recv_buffer straight into the ghost cells
+ *
+ * @param codec The state of the neighbor
+ * @param size The size of the received message in bytes
+ * @param cells The ghost cells
+ */
+void decodeHaloMessage(HaloCodec* codec, int size, unsigned char* cells);
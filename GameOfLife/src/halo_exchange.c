@@ -0,0 +1,460 @@
+#include "halo_exchange.h"
+
+#include <assert.h>
+#include <stdlib.h> // free
+#include <string.h> // strcmp, memcpy
+
+#include "memory_placement.h"
+#include "utils.h"
+#include "utils_grid.h"
+
+
+int parseHaloBackend(const char* name) {
+    if (strcmp(name, "isend") == 0) {
+        return HALO_ISEND;
+    } else if (strcmp(name, "persistent") == 0) {
+        return HALO_PERSISTENT;
+    } else if (strcmp(name, "neighbor") == 0) {
+        return HALO_NEIGHBOR;
+    } else if (strcmp(name, "shared") == 0) {
+        return HALO_SHARED;
+    } else if (strcmp(name, "rma") == 0) {
+        return HALO_RMA;
+    }
+    return -1;
+}
+
+const char* haloBackendName(int backend) {
+    switch (backend) {
+        case HALO_ISEND: return "isend";
+        case HALO_PERSISTENT: return "persistent";
+        case HALO_NEIGHBOR: return "neighbor";
+        case HALO_SHARED: return "shared";
+        case HALO_RMA: return "rma";
+        default: return "unknown";
+    }
+}
+
+
+/*
+ * A neighbor gets the halo_depth rows from update_start_row on (lower) or up to update_end_row (upper),
+ * they arrive in the ghost rows from row 0 on or after update_end_row. The rows are contiguous, so one message carries them
+ */
+static int upperBorderRow(WorkerConfig cfg) {
+    return cfg.update_end_row - cfg.halo_depth + 1;
+}
+
+static int upperGhostRow(WorkerConfig cfg) {
+    return cfg.update_end_row + 1;
+}
+
+static int haloCells(WorkerConfig cfg) {
+    return cfg.halo_depth * cfg.grid_width;
+}
+
+
+static void initPersistentRequests(HaloExchange* halo, WorkerConfig cfg) {
+    // same order as in sendandReceiveUpdatedGridRows: sends first, then receives. One set per grid buffer
+    for (int buffer = 0; buffer < 2; buffer++) {
+        unsigned char** grid = halo->grids[buffer];
+        MPI_Request* requests = halo->requests[buffer];
+        halo->request_count = 0;
+        if (halo->lower_rank != MPI_PROC_NULL) {
+            MPI_Send_init(grid[cfg.update_start_row], haloCells(cfg), MPI_CHAR, halo->lower_rank, 0, MPI_COMM_WORLD, &requests[halo->request_count++]);
+        }
+        if (halo->upper_rank != MPI_PROC_NULL) {
+            MPI_Send_init(grid[upperBorderRow(cfg)], haloCells(cfg), MPI_CHAR, halo->upper_rank, 0, MPI_COMM_WORLD, &requests[halo->request_count++]);
+        }
+        if (halo->lower_rank != MPI_PROC_NULL) {
+            MPI_Recv_init(grid[0], haloCells(cfg), MPI_CHAR, halo->lower_rank, 0, MPI_COMM_WORLD, &requests[halo->request_count++]);
+        }
+        if (halo->upper_rank != MPI_PROC_NULL) {
+            MPI_Recv_init(grid[upperGhostRow(cfg)], haloCells(cfg), MPI_CHAR, halo->upper_rank, 0, MPI_COMM_WORLD, &requests[halo->request_count++]);
+        }
+    }
+}
+
+
+static int currentBuffer(const HaloExchange* halo, WorkerConfig cfg) {
+    return cfg.local_grid == halo->grids[0] ? 0 : 1;
+}
+
+
+static void initNeighborGraph(HaloExchange* halo, MPI_Comm worker_comm) {
+    // the worker communicator is ordered by world rank without the main process
+    int neighbors[2] = {0, 0};
+    int weights[2] = {1, 1}; // real arrays even without a neighbor, MPI_UNWEIGHTED points to nothing
+    int count = 0;
+    if (halo->lower_rank != MPI_PROC_NULL) {
+        neighbors[count++] = halo->lower_rank - 1;
+    }
+    if (halo->upper_rank != MPI_PROC_NULL) {
+        neighbors[count++] = halo->upper_rank - 1;
+    }
+    halo->neighbor_count = count;
+
+    // sources and destinations are the same, the k-th received block comes from neighbors[k]
+    MPI_Dist_graph_create_adjacent(worker_comm, count, neighbors, weights, count, neighbors, weights, MPI_INFO_NULL, 0, &halo->graph_comm);
+}
+
+
+static int toSharedRank(MPI_Group world_group, MPI_Group shm_group, int world_rank) {
+    if (world_rank == MPI_PROC_NULL) {
+        return MPI_PROC_NULL;
+    }
+    int shm_rank;
+    MPI_Group_translate_ranks(world_group, 1, &world_rank, shm_group, &shm_rank);
+    return shm_rank == MPI_UNDEFINED ? MPI_PROC_NULL : shm_rank;
+}
+
+
+static unsigned char* sharedSegment(HaloExchange* halo, int shm_rank) {
+    MPI_Aint size; // rounded up by some implementations, so it can't be used to find the rows
+    int disp_unit;
+    unsigned char* base;
+    MPI_Win_shared_query(halo->shm_win, shm_rank, &size, &disp_unit, &base);
+    return base;
+}
+
+
+static void initSharedWindow(HaloExchange* halo, WorkerConfig* cfg, MPI_Comm worker_comm) {
+    MPI_Comm_split_type(worker_comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &halo->shm_comm);
+
+    // every segment should stay on the memory of the worker that updates it
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "alloc_shared_noncontig", "true");
+    MPI_Aint size = 2 * (MPI_Aint)cfg->num_rows * cfg->grid_width;
+    MPI_Win_allocate_shared(size, 1, info, halo->shm_comm, &halo->grid_block, &halo->shm_win);
+    MPI_Info_free(&info);
+
+    MPI_Group world_group, shm_group;
+    MPI_Comm_group(MPI_COMM_WORLD, &world_group);
+    MPI_Comm_group(halo->shm_comm, &shm_group);
+    halo->lower_shm_rank = toSharedRank(world_group, shm_group, halo->lower_rank);
+    halo->upper_shm_rank = toSharedRank(world_group, shm_group, halo->upper_rank);
+    MPI_Group_free(&world_group);
+    MPI_Group_free(&shm_group);
+}
+
+
+/**
+ * Points the ghost rows of both buffers to the border rows of the same buffer of the neighbors on this node.
+ * All workers swap their buffers in the same generation, so the ghost rows always show the current generation
+ */
+static void linkSharedGhostRows(HaloExchange* halo, WorkerConfig* cfg) {
+    // tell the neighbors on this node where in the segment their ghost rows are
+    MPI_Aint buffer_size = (MPI_Aint)cfg->num_rows * cfg->grid_width;
+    MPI_Aint start_offsets[2], end_offsets[2];
+    MPI_Aint lower_offsets[2] = {0, 0}, upper_offsets[2] = {0, 0};
+    for (int buffer = 0; buffer < 2; buffer++) {
+        start_offsets[buffer] = buffer * buffer_size + (MPI_Aint)cfg->update_start_row * cfg->grid_width;
+        end_offsets[buffer] = buffer * buffer_size + (MPI_Aint)upperBorderRow(*cfg) * cfg->grid_width;
+    }
+    MPI_Sendrecv(start_offsets, 2, MPI_AINT, halo->lower_shm_rank, 0, upper_offsets, 2, MPI_AINT, halo->upper_shm_rank, 0, halo->shm_comm, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(end_offsets, 2, MPI_AINT, halo->upper_shm_rank, 0, lower_offsets, 2, MPI_AINT, halo->lower_shm_rank, 0, halo->shm_comm, MPI_STATUS_IGNORE);
+
+    for (int buffer = 0; buffer < 2; buffer++) {
+        for (int k = 0; k < cfg->halo_depth; k++) {
+            if (halo->lower_shm_rank != MPI_PROC_NULL) {
+                halo->grids[buffer][k] = sharedSegment(halo, halo->lower_shm_rank) + lower_offsets[buffer] + (MPI_Aint)k * cfg->grid_width;
+            }
+            if (halo->upper_shm_rank != MPI_PROC_NULL) {
+                halo->grids[buffer][upperGhostRow(*cfg) + k] = sharedSegment(halo, halo->upper_shm_rank) + upper_offsets[buffer] + (MPI_Aint)k * cfg->grid_width;
+            }
+        }
+    }
+
+    // passive target epoch for the whole run, MPI_Win_sync acts as memory barrier
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, halo->shm_win);
+}
+
+
+static void initRmaWindow(HaloExchange* halo, WorkerConfig* cfg, MPI_Comm worker_comm) {
+    // the window allocates the local grid, so the implementation can register the memory for remote access
+    MPI_Aint buffer_size = (MPI_Aint)cfg->num_rows * cfg->grid_width;
+    MPI_Win_allocate(2 * buffer_size, 1, MPI_INFO_NULL, worker_comm, &halo->grid_block, &halo->rma_win);
+
+    // tell the neighbors where the ghost rows of both buffers are
+    MPI_Aint lower_ghost_disps[2], upper_ghost_disps[2];
+    for (int buffer = 0; buffer < 2; buffer++) {
+        lower_ghost_disps[buffer] = buffer * buffer_size;
+        upper_ghost_disps[buffer] = buffer * buffer_size + (MPI_Aint)upperGhostRow(*cfg) * cfg->grid_width;
+        halo->lower_ghost_disp[buffer] = 0;
+        halo->upper_ghost_disp[buffer] = 0;
+    }
+    MPI_Sendrecv(upper_ghost_disps, 2, MPI_AINT, halo->upper_rank, 0, halo->lower_ghost_disp, 2, MPI_AINT, halo->lower_rank, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(lower_ghost_disps, 2, MPI_AINT, halo->lower_rank, 0, halo->upper_ghost_disp, 2, MPI_AINT, halo->upper_rank, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    // the worker communicator is ordered by world rank without the main process
+    int neighbors[2];
+    int count = 0;
+    if (halo->lower_rank != MPI_PROC_NULL) {
+        neighbors[count++] = halo->lower_rank - 1;
+    }
+    if (halo->upper_rank != MPI_PROC_NULL) {
+        neighbors[count++] = halo->upper_rank - 1;
+    }
+    MPI_Group worker_group;
+    MPI_Comm_group(worker_comm, &worker_group);
+    MPI_Group_incl(worker_group, count, neighbors, &halo->rma_group);
+    MPI_Group_free(&worker_group);
+}
+
+
+void initHaloExchange(HaloExchange* halo, WorkerConfig* cfg, MPI_Comm worker_comm) {
+    int worker_idx = cfg->world_rank - 1;
+    int worker_count = cfg->world_size - 1;
+
+    halo->backend = cfg->halo_backend;
+    halo->lower_rank = worker_idx > 0 ? cfg->world_rank - 1 : MPI_PROC_NULL;
+    halo->upper_rank = worker_idx < worker_count - 1 ? cfg->world_rank + 1 : MPI_PROC_NULL;
+    halo->encoding = cfg->halo_encoding;
+    halo->bytes_sent = 0;
+    if (halo->encoding != HALO_ENCODING_RAW) {
+        initHaloCodec(&halo->lower_codec, haloCells(*cfg));
+        initHaloCodec(&halo->upper_codec, haloCells(*cfg));
+    }
+    halo->request_count = 0;
+    halo->graph_comm = MPI_COMM_NULL;
+    halo->neighbor_count = 0;
+    halo->shm_comm = MPI_COMM_NULL;
+    halo->shm_win = MPI_WIN_NULL;
+    halo->rma_win = MPI_WIN_NULL;
+    halo->rma_group = MPI_GROUP_NULL;
+    halo->grid_block = NULL;
+
+    if (halo->backend == HALO_SHARED) {
+        initSharedWindow(halo, cfg, worker_comm);
+    } else if (halo->backend == HALO_RMA) {
+        initRmaWindow(halo, cfg, worker_comm);
+    }
+    // the kernel reads local_grid and writes next_grid
+    size_t buffer_size = (size_t)cfg->num_rows * cfg->grid_width;
+    if (halo->grid_block == NULL) {
+        halo->grid_block = allocateGridMemory(2 * buffer_size, cfg->page_mode, &halo->page_mode);
+    } else if (cfg->page_mode != PAGES_DEFAULT) {
+        halo->page_mode = adviseGridMemory(halo->grid_block, 2 * buffer_size); // the window allocated it, MAP_HUGETLB is not possible
+    } else {
+        halo->page_mode = PAGES_DEFAULT;
+    }
+    halo->grids[0] = createGridView(halo->grid_block, cfg->num_rows, cfg->grid_width);
+    halo->grids[1] = createGridView(halo->grid_block + buffer_size, cfg->num_rows, cfg->grid_width);
+    cfg->local_grid = halo->grids[0];
+    cfg->next_grid = halo->grids[1];
+
+    switch (halo->backend) {
+        case HALO_PERSISTENT:
+            initPersistentRequests(halo, *cfg);
+            break;
+        case HALO_NEIGHBOR:
+            initNeighborGraph(halo, worker_comm);
+            break;
+        case HALO_SHARED:
+            linkSharedGhostRows(halo, cfg);
+            break;
+        default:
+            break;
+    }
+    debugPrint("Rank %d: halo exchange backend %s\n", cfg->world_rank, haloBackendName(halo->backend));
+}
+
+
+static void exchangeNeighborAlltoallw(HaloExchange* halo, WorkerConfig cfg) {
+    int counts[2] = {haloCells(cfg), haloCells(cfg)};
+    MPI_Datatype types[2] = {MPI_CHAR, MPI_CHAR};
+    MPI_Aint send_displs[2];
+    MPI_Aint recv_displs[2];
+
+    // send and receive rows are addressed absolutely, relative to MPI_BOTTOM
+    int n = 0;
+    if (halo->lower_rank != MPI_PROC_NULL) {
+        MPI_Get_address(cfg.local_grid[cfg.update_start_row], &send_displs[n]);
+        MPI_Get_address(cfg.local_grid[0], &recv_displs[n]);
+        n++;
+    }
+    if (halo->upper_rank != MPI_PROC_NULL) {
+        MPI_Get_address(cfg.local_grid[upperBorderRow(cfg)], &send_displs[n]);
+        MPI_Get_address(cfg.local_grid[upperGhostRow(cfg)], &recv_displs[n]);
+        n++;
+    }
+    assert(n == halo->neighbor_count);
+
+    MPI_Neighbor_alltoallw(MPI_BOTTOM, counts, send_displs, types, MPI_BOTTOM, counts, recv_displs, types, halo->graph_comm);
+}
+
+
+/**
+ * Posts the two-sided messages with the border rows to the given neighbors, encoded if configured.
+ * requests[0] and requests[1] belong to the lower, requests[2] and requests[3] to the upper neighbor
+ */
+static void startHaloMessages(HaloExchange* halo, WorkerConfig cfg, int lower_rank, int upper_rank, MPI_Request* requests) {
+    for (int i = 0; i < 4; i++) {
+        requests[i] = MPI_REQUEST_NULL;
+    }
+
+    if (lower_rank != MPI_PROC_NULL) {
+        if (halo->encoding == HALO_ENCODING_RAW) {
+            MPI_Isend(cfg.local_grid[cfg.update_start_row], haloCells(cfg), MPI_CHAR, lower_rank, 0, MPI_COMM_WORLD, &requests[0]);
+            MPI_Irecv(cfg.local_grid[0], haloCells(cfg), MPI_CHAR, lower_rank, 0, MPI_COMM_WORLD, &requests[1]);
+            halo->bytes_sent += haloCells(cfg);
+        } else {
+            int size = encodeHaloMessage(&halo->lower_codec, cfg.local_grid[cfg.update_start_row], halo->encoding);
+            MPI_Isend(halo->lower_codec.send_buffer, size, MPI_BYTE, lower_rank, 0, MPI_COMM_WORLD, &requests[0]);
+            MPI_Irecv(halo->lower_codec.recv_buffer, halo->lower_codec.capacity, MPI_BYTE, lower_rank, 0, MPI_COMM_WORLD, &requests[1]);
+            halo->bytes_sent += size;
+        }
+    }
+    if (upper_rank != MPI_PROC_NULL) {
+        if (halo->encoding == HALO_ENCODING_RAW) {
+            MPI_Isend(cfg.local_grid[upperBorderRow(cfg)], haloCells(cfg), MPI_CHAR, upper_rank, 0, MPI_COMM_WORLD, &requests[2]);
+            MPI_Irecv(cfg.local_grid[upperGhostRow(cfg)], haloCells(cfg), MPI_CHAR, upper_rank, 0, MPI_COMM_WORLD, &requests[3]);
+            halo->bytes_sent += haloCells(cfg);
+        } else {
+            int size = encodeHaloMessage(&halo->upper_codec, cfg.local_grid[upperBorderRow(cfg)], halo->encoding);
+            MPI_Isend(halo->upper_codec.send_buffer, size, MPI_BYTE, upper_rank, 0, MPI_COMM_WORLD, &requests[2]);
+            MPI_Irecv(halo->upper_codec.recv_buffer, halo->upper_codec.capacity, MPI_BYTE, upper_rank, 0, MPI_COMM_WORLD, &requests[3]);
+            halo->bytes_sent += size;
+        }
+    }
+}
+
+
+/**
+ * Waits for the messages of startHaloMessages and decodes the encoded ones into the ghost rows
+ */
+static void finishHaloMessages(HaloExchange* halo, WorkerConfig cfg, MPI_Request* requests) {
+    MPI_Status statuses[4];
+    MPI_Waitall(4, requests, statuses);
+    if (halo->encoding == HALO_ENCODING_RAW) {
+        return;
+    }
+
+    int size;
+    if (statuses[1].MPI_SOURCE != MPI_ANY_SOURCE) { // a null request leaves an empty status
+        MPI_Get_count(&statuses[1], MPI_BYTE, &size);
+        decodeHaloMessage(&halo->lower_codec, size, cfg.local_grid[0]);
+    }
+    if (statuses[3].MPI_SOURCE != MPI_ANY_SOURCE) {
+        MPI_Get_count(&statuses[3], MPI_BYTE, &size);
+        decodeHaloMessage(&halo->upper_codec, size, cfg.local_grid[upperGhostRow(cfg)]);
+    }
+}
+
+
+/**
+ * Zero byte messages to the neighbors on the same node, returns when both neighbors reached the same point
+ */
+static void syncSharedNeighbors(HaloExchange* halo) {
+    MPI_Request requests[4];
+    MPI_Isend(NULL, 0, MPI_BYTE, halo->lower_shm_rank, 0, halo->shm_comm, &requests[0]);
+    MPI_Isend(NULL, 0, MPI_BYTE, halo->upper_shm_rank, 0, halo->shm_comm, &requests[1]);
+    MPI_Irecv(NULL, 0, MPI_BYTE, halo->lower_shm_rank, 0, halo->shm_comm, &requests[2]);
+    MPI_Irecv(NULL, 0, MPI_BYTE, halo->upper_shm_rank, 0, halo->shm_comm, &requests[3]);
+    MPI_Waitall(4, requests, MPI_STATUSES_IGNORE);
+}
+
+
+static void exchangeShared(HaloExchange* halo, WorkerConfig cfg) {
+    // neighbors on another node still get their border row as a message
+    MPI_Request requests[4];
+    int lower_message_rank = halo->lower_shm_rank == MPI_PROC_NULL ? halo->lower_rank : MPI_PROC_NULL;
+    int upper_message_rank = halo->upper_shm_rank == MPI_PROC_NULL ? halo->upper_rank : MPI_PROC_NULL;
+    startHaloMessages(halo, cfg, lower_message_rank, upper_message_rank, requests);
+
+    // the ghost rows point into the buffers of the neighbors on this node. Once they finished their update
+    // their new generation is readable, and they no longer read the buffer this worker writes next
+    MPI_Win_sync(halo->shm_win);
+    syncSharedNeighbors(halo);
+    MPI_Win_sync(halo->shm_win);
+
+    finishHaloMessages(halo, cfg, requests);
+}
+
+
+static void exchangeRma(HaloExchange* halo, WorkerConfig cfg) {
+    // exposure epoch: the neighbors may write the ghost rows, the update of this worker is done reading them
+    MPI_Win_post(halo->rma_group, 0, halo->rma_win);
+    MPI_Win_start(halo->rma_group, 0, halo->rma_win);
+
+    // the worker communicator is ordered by world rank without the main process.
+    // All workers swap their buffers in the same generation, so the target is the same buffer
+    int buffer = currentBuffer(halo, cfg);
+    if (halo->lower_rank != MPI_PROC_NULL) {
+        MPI_Put(cfg.local_grid[cfg.update_start_row], haloCells(cfg), MPI_CHAR, halo->lower_rank - 1, halo->lower_ghost_disp[buffer], haloCells(cfg), MPI_CHAR, halo->rma_win);
+    }
+    if (halo->upper_rank != MPI_PROC_NULL) {
+        MPI_Put(cfg.local_grid[upperBorderRow(cfg)], haloCells(cfg), MPI_CHAR, halo->upper_rank - 1, halo->upper_ghost_disp[buffer], haloCells(cfg), MPI_CHAR, halo->rma_win);
+    }
+
+    MPI_Win_complete(halo->rma_win); // the border rows may be updated again
+    MPI_Win_wait(halo->rma_win); // the ghost rows have arrived
+}
+
+
+void exchangeHaloRows(HaloExchange* halo, WorkerConfig cfg) {
+    int neighbor_count = (halo->lower_rank != MPI_PROC_NULL) + (halo->upper_rank != MPI_PROC_NULL);
+    MPI_Request requests[4];
+
+    switch (halo->backend) {
+        case HALO_PERSISTENT:
+            if (halo->request_count > 0) {
+                MPI_Request* current_requests = halo->requests[currentBuffer(halo, cfg)];
+                MPI_Startall(halo->request_count, current_requests);
+                MPI_Waitall(halo->request_count, current_requests, MPI_STATUSES_IGNORE);
+            }
+            break;
+        case HALO_NEIGHBOR:
+            exchangeNeighborAlltoallw(halo, cfg);
+            break;
+        case HALO_SHARED:
+            exchangeShared(halo, cfg); // counts the messages to the other nodes itself
+            return;
+        case HALO_RMA:
+            exchangeRma(halo, cfg);
+            break;
+        default:
+            if (halo->encoding == HALO_ENCODING_RAW) {
+                sendandReceiveUpdatedGridRows(cfg);
+                break;
+            }
+            startHaloMessages(halo, cfg, halo->lower_rank, halo->upper_rank, requests);
+            finishHaloMessages(halo, cfg, requests);
+            return; // counted while encoding
+    }
+    halo->bytes_sent += (long long)neighbor_count * haloCells(cfg);
+}
+
+
+void freeHaloExchange(HaloExchange* halo, WorkerConfig* cfg) {
+    if (halo->encoding != HALO_ENCODING_RAW) {
+        freeHaloCodec(&halo->lower_codec);
+        freeHaloCodec(&halo->upper_codec);
+    }
+    for (int i = 0; i < halo->request_count; i++) {
+        MPI_Request_free(&halo->requests[0][i]);
+        MPI_Request_free(&halo->requests[1][i]);
+    }
+    halo->request_count = 0;
+    if (halo->graph_comm != MPI_COMM_NULL) {
+        MPI_Comm_free(&halo->graph_comm);
+    }
+
+    freeGridView(halo->grids[0]);
+    freeGridView(halo->grids[1]);
+    cfg->local_grid = NULL;
+    cfg->next_grid = NULL;
+    if (halo->shm_win != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(halo->shm_win);
+        MPI_Win_free(&halo->shm_win); // also releases the grid memory
+        MPI_Comm_free(&halo->shm_comm);
+    } else if (halo->rma_win != MPI_WIN_NULL) {
+        MPI_Win_free(&halo->rma_win); // also releases the grid memory
+        if (halo->rma_group != MPI_GROUP_EMPTY) {
+            MPI_Group_free(&halo->rma_group);
+        }
+    } else {
+        freeGridMemory(halo->grid_block, 2 * (size_t)cfg->num_rows * cfg->grid_width, halo->page_mode);
+    }
+    halo->grid_block = NULL;
+}
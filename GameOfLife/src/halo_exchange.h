@@ -0,0 +1,101 @@
+#pragma once
+
+#include <mpi.h>
+
+#include "game_of_life_mpi.h"
+#include "halo_codec.h"
+
+/**
+ * Available implementations of the per generation halo exchange
+ */
+enum HaloBackend {
+    HALO_ISEND = 0,       // fresh MPI_Isend/MPI_Irecv every generation (sendandReceiveUpdatedGridRows)
+    HALO_PERSISTENT = 1,  // persistent requests created once, started with MPI_Startall
+    HALO_NEIGHBOR = 2,    // MPI_Neighbor_alltoallw on a distributed graph topology
+    HALO_SHARED = 3,      // direct loads from MPI shared memory windows on the same node, messages between nodes
+    HALO_RMA = 4          // one sided MPI_Put into the ghost rows, post-start-complete-wait with the neighbors only
+};
+
+/**
+ * State of the halo exchange of one worker, created once before the first generation
+ *
+ * @param backend The selected HaloBackend
+ * @param lower_rank The world rank of the lower neighbor or MPI_PROC_NULL
+ * @param upper_rank The world rank of the upper neighbor or MPI_PROC_NULL
+ * @param grids The row views of both grid buffers, the workers swap local_grid and next_grid every generation
+ * @param requests The persistent requests of both buffers (only HALO_PERSISTENT)
+ * @param graph_comm The distributed graph communicator (only HALO_NEIGHBOR)
+ * @param shm_comm The communicator of the workers on the same node (only HALO_SHARED)
+ * @param rma_win The window over the local grid the neighbors put their border rows into (only HALO_RMA)
+ * @param encoding The HaloEncoding of the two-sided messages (HALO_ISEND and the other nodes of HALO_SHARED)
+ */
+struct HaloExchange {
+    int backend;
+    int lower_rank;
+    int upper_rank;
+
+    int encoding;
+    HaloCodec lower_codec;
+    HaloCodec upper_codec;
+    long long bytes_sent; // payload sent to the neighbors over all generations
+
+    unsigned char* grid_block; // contiguous memory behind the rows of both grid buffers
+    int page_mode; // PageMode the grid block got
+    unsigned char** grids[2];
+
+    MPI_Request requests[2][4];
+    int request_count;
+
+    MPI_Comm graph_comm;
+    int neighbor_count; // number of sources and destinations in graph_comm
+
+    MPI_Comm shm_comm;
+    MPI_Win shm_win; // holds the local grid of every worker on the node
+    int lower_shm_rank; // rank of the lower neighbor in shm_comm, MPI_PROC_NULL if it is on another node
+    int upper_shm_rank;
+
+    MPI_Win rma_win;
+    MPI_Group rma_group; // the neighbors, used for the access and the exposure epoch
+    MPI_Aint lower_ghost_disp[2]; // displacement of the upper ghost row of the lower neighbor in its window, per buffer
+    MPI_Aint upper_ghost_disp[2]; // displacement of the lower ghost row of the upper neighbor in its window, per buffer
+};
+typedef struct HaloExchange HaloExchange;
+
+/**
+ * Parses the name of a halo backend
+ *
+ * @param name Either "isend", "persistent", "neighbor", "shared" or "rma"
+ * @return The HaloBackend or -1 if the name is unknown
+ */
+int parseHaloBackend(const char* name);
+
+const char* haloBackendName(int backend);
+
+/**
+ * Sets up the selected halo exchange backend for the worker and allocates both grid buffers (cfg->local_grid and cfg->next_grid)
+ * in the memory the backend needs. The buffers are contiguous, HALO_SHARED and HALO_RMA place them in their window.
+ * With HALO_SHARED the ghost rows of neighbors on the same node point into the buffers of the neighbors.
+ * Has to be called before receiveInitialGrid
+ *
+ * @param halo The halo exchange to initialize
+ * @param cfg The worker process Config
+ * @param worker_comm The communicator of all workers
+ */
+void initHaloExchange(HaloExchange* halo, WorkerConfig* cfg, MPI_Comm worker_comm);
+
+/**
+ * Sends the cfg.halo_depth updated border rows to the neighbors and receives their border rows into the ghost rows.
+ * Works on the current buffer (cfg.local_grid), so it is called after swapGrids
+ *
+ * @param halo The halo exchange state
+ * @param cfg The worker process Config
+ */
+void exchangeHaloRows(HaloExchange* halo, WorkerConfig cfg);
+
+/**
+ * Frees the halo exchange and the grid buffers allocated by initHaloExchange
+ *
+ * @param halo The halo exchange state
+ * @param cfg The worker process Config
+ */
+void freeHaloExchange(HaloExchange* halo, WorkerConfig* cfg);
@@ -0,0 +1,181 @@
+#include "history_store.h"
+
+#include <stdlib.h>
+#include <string.h> // memcmp, memcpy
+
+#include "halo_codec.h"
+
+
+#define HISTORY_MAGIC "GOLHIST1"
+
+/**
+ * The start of a history file, the decomposition it was recorded with
+ */
+struct HistoryHeader {
+    char magic[8];
+    int world_size;
+    int row_index_main_grid;
+    int update_row_count;
+    int grid_width;
+    int keyframe_interval;
+};
+typedef struct HistoryHeader HistoryHeader;
+
+/**
+ * The end of a history file, the index is written after the last frame
+ */
+struct HistoryFooter {
+    long long index_offset;
+    int frame_count;
+    char magic[8];
+};
+typedef struct HistoryFooter HistoryFooter;
+
+
+static void quitWithHistoryError(const char* file_name, const char* reason) {
+    fprintf(stderr, "Error: history file %s: %s\n", file_name, reason);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+static const unsigned char* updatedCells(WorkerConfig cfg) {
+    // the rows of a buffer are contiguous, the updated ones are one block
+    return cfg.local_grid[cfg.update_start_row];
+}
+
+
+void openHistoryRecorder(HistoryRecorder* recorder, WorkerConfig cfg, int keyframe_interval) {
+    char file_name[64];
+    snprintf(file_name, sizeof(file_name), HISTORY_FILE_NAME, cfg.world_rank);
+    recorder->file = fopen(file_name, "wb");
+    if (recorder->file == NULL) {
+        quitWithHistoryError(file_name, "cannot be created");
+    }
+    recorder->keyframe_interval = keyframe_interval;
+    recorder->length = cfg.update_row_count * cfg.grid_width;
+    // runs that do not beat the bit-packed cells are not worth it
+    recorder->capacity = packedSize(recorder->length);
+    recorder->previous = malloc(recorder->length);
+    recorder->buffer = malloc(recorder->capacity);
+    recorder->frame_capacity = 1024;
+    recorder->frames = malloc(recorder->frame_capacity * sizeof(HistoryFrame));
+    if (recorder->previous == NULL || recorder->buffer == NULL || recorder->frames == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the history\n");
+        exit(1);
+    }
+    recorder->frame_count = 0;
+    recorder->bytes_written = 0;
+
+    HistoryHeader header = {.world_size = cfg.world_size, .row_index_main_grid = cfg.row_index_main_grid, .update_row_count = cfg.update_row_count,
+        .grid_width = cfg.grid_width, .keyframe_interval = keyframe_interval};
+    memcpy(header.magic, HISTORY_MAGIC, sizeof(header.magic));
+    fwrite(&header, sizeof(header), 1, recorder->file);
+    recordGeneration(recorder, cfg);
+}
+
+
+void recordGeneration(HistoryRecorder* recorder, WorkerConfig cfg) {
+    const unsigned char* cells = updatedCells(cfg);
+    bool keyframe = recorder->frame_count % recorder->keyframe_interval == 0;
+    HistoryFrame frame = {.offset = ftell(recorder->file)};
+    if (!keyframe && memcmp(cells, recorder->previous, recorder->length) == 0) {
+        frame.format = HALO_FORMAT_UNCHANGED;
+        frame.size = 0;
+    } else {
+        frame.size = encodeRuns(cells, keyframe ? NULL : recorder->previous, recorder->length, recorder->buffer, recorder->capacity);
+        frame.format = keyframe ? HALO_FORMAT_RUNS : HALO_FORMAT_DELTA_RUNS;
+        if (frame.size < 0) {
+            // too busy for runs, the frame is complete then
+            packCells(cells, recorder->length, recorder->buffer);
+            frame.size = recorder->capacity;
+            frame.format = HALO_FORMAT_PACKED;
+        }
+        fwrite(recorder->buffer, 1, frame.size, recorder->file);
+        memcpy(recorder->previous, cells, recorder->length);
+    }
+
+    if (recorder->frame_count == recorder->frame_capacity) {
+        recorder->frame_capacity *= 2;
+        recorder->frames = realloc(recorder->frames, recorder->frame_capacity * sizeof(HistoryFrame));
+        if (recorder->frames == NULL) {
+            fprintf(stderr, "Failed to allocate memory for the history index\n");
+            exit(1);
+        }
+    }
+    recorder->frames[recorder->frame_count++] = frame;
+    recorder->bytes_written += frame.size;
+}
+
+
+void closeHistoryRecorder(HistoryRecorder* recorder) {
+    HistoryFooter footer = {.index_offset = ftell(recorder->file), .frame_count = recorder->frame_count};
+    memcpy(footer.magic, HISTORY_MAGIC, sizeof(footer.magic));
+    fwrite(recorder->frames, sizeof(HistoryFrame), recorder->frame_count, recorder->file);
+    fwrite(&footer, sizeof(footer), 1, recorder->file);
+    fclose(recorder->file);
+    free(recorder->previous);
+    free(recorder->buffer);
+    free(recorder->frames);
+}
+
+
+void rebuildGeneration(WorkerConfig* cfg, int generation) {
+    char file_name[64];
+    snprintf(file_name, sizeof(file_name), HISTORY_FILE_NAME, cfg->world_rank);
+    FILE* file = fopen(file_name, "rb");
+    if (file == NULL) {
+        quitWithHistoryError(file_name, "cannot be opened");
+    }
+    HistoryHeader header;
+    HistoryFooter footer;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, HISTORY_MAGIC, sizeof(header.magic)) != 0
+        || fseek(file, -(long)sizeof(footer), SEEK_END) != 0 || fread(&footer, sizeof(footer), 1, file) != 1
+        || memcmp(footer.magic, HISTORY_MAGIC, sizeof(footer.magic)) != 0) {
+        quitWithHistoryError(file_name, "is not a complete history");
+    }
+    if (header.world_size != cfg->world_size || header.row_index_main_grid != cfg->row_index_main_grid
+        || header.update_row_count != cfg->update_row_count || header.grid_width != cfg->grid_width) {
+        quitWithHistoryError(file_name, "was recorded with another size or number of processes");
+    }
+    if (generation >= footer.frame_count) {
+        quitWithHistoryError(file_name, "does not reach the generation");
+    }
+
+    HistoryFrame* frames = malloc(footer.frame_count * sizeof(HistoryFrame));
+    int length = cfg->update_row_count * cfg->grid_width;
+    unsigned char* buffer = malloc(packedSize(length));
+    if (frames == NULL || buffer == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the history\n");
+        exit(1);
+    }
+    fseek(file, footer.index_offset, SEEK_SET);
+    if (fread(frames, sizeof(HistoryFrame), footer.frame_count, file) != (size_t)footer.frame_count) {
+        quitWithHistoryError(file_name, "has a broken index");
+    }
+
+    // the frames from the keyframe on are contiguous
+    unsigned char* cells = cfg->local_grid[cfg->update_start_row];
+    int keyframe = generation - generation % header.keyframe_interval;
+    fseek(file, frames[keyframe].offset, SEEK_SET);
+    for (int g = keyframe; g <= generation; g++) {
+        const HistoryFrame* frame = &frames[g];
+        if (fread(buffer, 1, frame->size, file) != (size_t)frame->size) {
+            quitWithHistoryError(file_name, "ends in the middle of a frame");
+        }
+        switch (frame->format) {
+            case HALO_FORMAT_PACKED:
+                unpackCells(buffer, length, cells);
+                break;
+            case HALO_FORMAT_RUNS:
+                decodeRuns(buffer, frame->size, NULL, length, cells);
+                break;
+            case HALO_FORMAT_DELTA_RUNS:
+                decodeRuns(buffer, frame->size, cells, length, cells);
+                break;
+            default: // HALO_FORMAT_UNCHANGED
+                break;
+        }
+    }
+    free(buffer);
+    free(frames);
+    fclose(file);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdio.h>
+
+#include "game_of_life_mpi.h"
+
+// every worker writes its rows to its own file, %d is the world rank
+#define HISTORY_FILE_NAME "mpi_history-%d.bin"
+
+/**
+ * An entry of the index at the end of a history file, one per generation
+ *
+ * @param offset The position of the frame in the file
+ * @param size The size of the frame in bytes
+ * @param format The HaloFormat of the frame: HALO_FORMAT_PACKED or HALO_FORMAT_RUNS are complete,
+ *               HALO_FORMAT_DELTA_RUNS and HALO_FORMAT_UNCHANGED apply to the generation before
+ */
+struct HistoryFrame {
+    long long offset;
+    int size;
+    int format;
+};
+typedef struct HistoryFrame HistoryFrame;
+
+/**
+ * Writes the generations of the rows of one worker. Every keyframe_interval generations the frame is complete,
+ * in between it holds the cells that changed (the XOR with the generation before) as runs, so a generation
+ * costs what changed and not the size of the rows
+ *
+ * @param file The history file
+ * @param keyframe_interval The generations between two complete frames
+ * @param length The number of cells of the rows of the worker
+ * @param previous The cells of the last recorded generation
+ * @param buffer The encoded frame
+ * @param capacity The size of buffer, a frame that does not fit as runs is bit-packed
+ * @param frames The index
+ * @param bytes_written Size of the frames
+ */
+struct HistoryRecorder {
+    FILE* file;
+    int keyframe_interval;
+    int length;
+    unsigned char* previous;
+    unsigned char* buffer;
+    int capacity;
+
+    HistoryFrame* frames;
+    int frame_count;
+    int frame_capacity;
+    long long bytes_written;
+};
+typedef struct HistoryRecorder HistoryRecorder;
+
+/**
+ * Creates the history file of the worker in the working directory and records the current generation as frame 0
+ *
+ * @param recorder The recorder to initialize
+ * @param cfg The worker process Config with the initial grid
+ * @param keyframe_interval The generations between two complete frames
+ */
+void openHistoryRecorder(HistoryRecorder* recorder, WorkerConfig cfg, int keyframe_interval);
+
+/**
+ * Records the current generation of the rows the worker updates (cfg.local_grid) as the next frame
+ */
+void recordGeneration(HistoryRecorder* recorder, WorkerConfig cfg);
+
+/**
+ * Writes the index and closes the file
+ */
+void closeHistoryRecorder(HistoryRecorder* recorder);
+
+/**
+ * Rebuilds a generation of the rows the worker updates from its history file: decodes the last keyframe at or before it
+ * and applies the deltas up to it. The file has to be written by a run with the same size and number of processes
+ *
+ * @param cfg The worker process Config, the rows are written to cfg->local_grid
+ * @param generation The generation to rebuild
+ */
+void rebuildGeneration(WorkerConfig* cfg, int generation);
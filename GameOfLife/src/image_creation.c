@@ -87,22 +87,14 @@ void write_jpeg_file(char *filename, unsigned char **bitArray, int width, int he
     struct jpeg_error_mgr jerr;
     FILE *outfile;
     JSAMPROW row_pointer[1];
-    int row_stride = width;
 
-    // Allocate memory for a temporary image where each pixel is a byte
-    unsigned char *image = malloc(width * height);
+    // one scanline at a time, a copy of the whole image would double the memory of the grid
+    unsigned char *image = malloc(width);
     if (!image) {
         fprintf(stderr, "Failed to allocate memory for the JPEG image\n");
         exit(1);
     }
 
-    // Convert bitArray to image
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            image[y * width + x] = bitArray[y][x] ? 0 : 255; // 0 for black (bit is 1), 255 for white (bit is 0)
-        }
-    }
-
     cinfo.err = jpeg_std_error(&jerr);
     jpeg_create_compress(&cinfo);
 
@@ -129,7 +121,12 @@ void write_jpeg_file(char *filename, unsigned char **bitArray, int width, int he
             // printf("%d/%d\n", counter, cinfo.image_height);
             fflush(stdout);
         //}
-        row_pointer[0] = &image[cinfo.next_scanline * row_stride];
+        // Convert a row of bitArray to the scanline
+        const unsigned char *cells = bitArray[cinfo.next_scanline];
+        for (int x = 0; x < width; ++x) {
+            image[x] = cells[x] ? 0 : 255; // 0 for black (bit is 1), 255 for white (bit is 0)
+        }
+        row_pointer[0] = image;
         jpeg_write_scanlines(&cinfo, row_pointer, 1);
         counter++;
     }
@@ -142,3 +139,33 @@ void write_jpeg_file(char *filename, unsigned char **bitArray, int width, int he
 }
 
 
+
+void write_pbm_file(char *filename, unsigned char **bitArray, int width, int height) {
+    FILE *outfile = fopen(filename, "wb");
+    if (outfile == NULL) {
+        fprintf(stderr, "can't open %s\n", filename);
+        exit(1);
+    }
+    fprintf(outfile, "P4\n%d %d\n", width, height);
+
+    // every row starts with a new byte, the first pixel is the highest bit
+    int row_size = (width + 7) / 8;
+    unsigned char *row = malloc(row_size);
+    if (!row) {
+        fprintf(stderr, "Failed to allocate memory for the PBM row\n");
+        exit(1);
+    }
+    for (int y = 0; y < height; ++y) {
+        for (int i = 0; i < row_size; ++i) {
+            row[i] = 0;
+        }
+        for (int x = 0; x < width; ++x) {
+            if (bitArray[y][x]) {
+                row[x / 8] |= 0x80 >> (x % 8);
+            }
+        }
+        fwrite(row, 1, row_size, outfile);
+    }
+    free(row);
+    fclose(outfile);
+}
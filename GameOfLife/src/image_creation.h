@@ -10,3 +10,13 @@
  */
 void write_jpeg_file(char *filename, unsigned char **bitArray, int width, int height);
 
+/**
+ * Writes a binary portable bitmap (P4) with the given bitArray, 8 pixels per byte and a bit is black if the cell is alive
+ * 
+ * @param filename The name of the file to be written
+ * @param bitArray The array of pixels to be written
+ * @param width The width of the bitArray and thefor the image
+ * @param height The height of the bitArray and thefor the image
+ */
+void write_pbm_file(char *filename, unsigned char **bitArray, int width, int height);
+
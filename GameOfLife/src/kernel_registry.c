@@ -0,0 +1,159 @@
+#include "kernel_registry.h"
+
+#include <mpi.h> // MPI_Wtime
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // strcmp, memcmp
+
+// at most this many rows of the local grid are used for the benchmark
+#define KERNEL_SAMPLE_ROWS 64
+// every candidate updates at least this many cells per measurement
+#define KERNEL_SAMPLE_CELLS (1 << 21)
+// the column tile widths tried for every kernel, the full width is always tried
+static const int tileWidths[] = {256, 1024, 4096};
+#define TILE_WIDTH_COUNT (int)(sizeof(tileWidths) / sizeof(tileWidths[0]))
+
+
+int parseUpdateKernel(const char* name) {
+    if (strcmp(name, "auto") == 0) {
+        return UPDATE_KERNEL_AUTO;
+    }
+    for (int kernel = 0; kernel < UPDATE_KERNEL_COUNT; kernel++) {
+        if (strcmp(name, updateKernels[kernel].name) == 0) {
+            return kernel;
+        }
+    }
+    return -1;
+}
+
+const char* updateKernelName(int kernel) {
+    if (kernel == UPDATE_KERNEL_AUTO) {
+        return "auto";
+    } else if (kernel < 0 || kernel >= UPDATE_KERNEL_COUNT) {
+        return "unknown";
+    }
+    return updateKernels[kernel].name;
+}
+
+bool isUpdateKernelSupported(int kernel) {
+    const UpdateKernel* entry = &updateKernels[kernel];
+    return entry->updateRow != NULL && (entry->isSupported == NULL || entry->isSupported());
+}
+
+
+/**
+ * Updates the rows first_row to last_row (inclusive) of grid into next, column tile by column tile,
+ * so the three rows of a tile stay in the cache while the tile moves down
+ */
+static void updateRows(UpdateRowFunction updateRow, int tile_width, unsigned char** grid, unsigned char** next, int first_row, int last_row, int num_rows, int width, const unsigned char* zero_row) {
+    for (int first_column = 0; first_column < width; first_column += tile_width) {
+        int last_column = first_column + tile_width < width ? first_column + tile_width : width;
+        for (int i = first_row; i <= last_row; i++) {
+            const unsigned char* above = i > 0 ? grid[i - 1] : zero_row;
+            const unsigned char* below = i < num_rows - 1 ? grid[i + 1] : zero_row;
+            updateRow(above, grid[i], below, next[i], width, first_column, last_column);
+        }
+    }
+}
+
+
+void updateGridWithKernel(const KernelChoice* choice, WorkerConfig cfg) {
+    updateRows(updateKernels[choice->kernel].updateRow, choice->tile_width, cfg.local_grid, cfg.next_grid,
+        cfg.update_start_row, cfg.update_end_row, cfg.num_rows, cfg.grid_width, choice->zero_row);
+}
+
+
+/**
+ * Returns the cells per second of the kernel on the sample rows, the best of three measurements
+ */
+static double benchmarkKernel(int kernel, int tile_width, WorkerConfig cfg, int last_row, unsigned char** sample_next, const unsigned char* zero_row) {
+    UpdateRowFunction updateRow = updateKernels[kernel].updateRow;
+    long long cells = (long long)(last_row - cfg.update_start_row + 1) * cfg.grid_width;
+    int repetitions = 1 + KERNEL_SAMPLE_CELLS / cells;
+
+    updateRows(updateRow, tile_width, cfg.local_grid, sample_next, cfg.update_start_row, last_row, cfg.num_rows, cfg.grid_width, zero_row); // warm up
+    double best = 0;
+    for (int measurement = 0; measurement < 3; measurement++) {
+        double start = MPI_Wtime();
+        for (int r = 0; r < repetitions; r++) {
+            updateRows(updateRow, tile_width, cfg.local_grid, sample_next, cfg.update_start_row, last_row, cfg.num_rows, cfg.grid_width, zero_row);
+        }
+        double elapsed = MPI_Wtime() - start;
+        double throughput = elapsed > 0 ? cells * repetitions / elapsed : 0;
+        if (throughput > best) {
+            best = throughput;
+        }
+    }
+    return best;
+}
+
+
+void selectUpdateKernel(KernelChoice* choice, WorkerConfig cfg) {
+    choice->zero_row = calloc(cfg.grid_width, 1);
+    if (choice->zero_row == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the zero row\n");
+        exit(1);
+    }
+    if (cfg.kernel != UPDATE_KERNEL_AUTO && !isUpdateKernelSupported(cfg.kernel)) {
+        fprintf(stderr, "Rank %d: the %s kernel is not supported by this CPU\n", cfg.world_rank, updateKernelName(cfg.kernel));
+        exit(1);
+    }
+
+    // the benchmark writes into scratch rows, the grid buffers of the worker are not touched.
+    // The scalar kernel is the reference for the results of the other kernels
+    int last_row = cfg.update_end_row;
+    if (last_row - cfg.update_start_row + 1 > KERNEL_SAMPLE_ROWS) {
+        last_row = cfg.update_start_row + KERNEL_SAMPLE_ROWS - 1;
+    }
+    int sample_rows = last_row - cfg.update_start_row + 1;
+    unsigned char* sample_block = malloc(2 * (size_t)sample_rows * cfg.grid_width);
+    unsigned char** sample_next = malloc(cfg.num_rows * sizeof(unsigned char*));
+    unsigned char** reference = malloc(cfg.num_rows * sizeof(unsigned char*));
+    if (sample_block == NULL || sample_next == NULL || reference == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the kernel benchmark\n");
+        exit(1);
+    }
+    for (int i = 0; i < sample_rows; i++) {
+        reference[cfg.update_start_row + i] = sample_block + (size_t)i * cfg.grid_width;
+        sample_next[cfg.update_start_row + i] = sample_block + (size_t)(sample_rows + i) * cfg.grid_width;
+    }
+    updateRows(updateKernels[UPDATE_KERNEL_SCALAR].updateRow, cfg.grid_width, cfg.local_grid, reference, cfg.update_start_row, last_row, cfg.num_rows, cfg.grid_width, choice->zero_row);
+
+    choice->kernel = -1;
+    choice->tile_width = cfg.grid_width;
+    choice->cells_per_second = 0;
+    for (int kernel = 0; kernel < UPDATE_KERNEL_COUNT; kernel++) {
+        if ((cfg.kernel != UPDATE_KERNEL_AUTO && kernel != cfg.kernel) || !isUpdateKernelSupported(kernel)) {
+            continue;
+        }
+        for (int t = 0; t <= TILE_WIDTH_COUNT; t++) {
+            int tile_width = t < TILE_WIDTH_COUNT ? tileWidths[t] : cfg.grid_width;
+            if (tile_width > cfg.grid_width || (t < TILE_WIDTH_COUNT && tile_width == cfg.grid_width)) {
+                continue;
+            }
+            double throughput = benchmarkKernel(kernel, tile_width, cfg, last_row, sample_next, choice->zero_row);
+            if (memcmp(reference[cfg.update_start_row], sample_next[cfg.update_start_row], (size_t)sample_rows * cfg.grid_width) != 0) {
+                fprintf(stderr, "Rank %d: the %s kernel computed a wrong generation and is skipped\n", cfg.world_rank, updateKernels[kernel].name);
+                break;
+            }
+            if (throughput > choice->cells_per_second) {
+                choice->kernel = kernel;
+                choice->tile_width = tile_width;
+                choice->cells_per_second = throughput;
+            }
+        }
+    }
+    if (choice->kernel < 0) {
+        choice->kernel = UPDATE_KERNEL_SCALAR; // only if a forced kernel failed the check
+    }
+
+    free(sample_block);
+    free(sample_next);
+    free(reference);
+}
+
+
+void freeKernelChoice(KernelChoice* choice) {
+    free(choice->zero_row);
+    choice->zero_row = NULL;
+}
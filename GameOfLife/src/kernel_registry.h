@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "game_of_life_mpi.h"
+
+/**
+ * The update kernels, the workers choose one at startup. All of them compute the same generation
+ */
+enum UpdateKernelId {
+    UPDATE_KERNEL_SCALAR = 0,    // reference implementation, one cell at a time
+    UPDATE_KERNEL_SSE2 = 1,      // 16 cells per instruction
+    UPDATE_KERNEL_AVX2 = 2,      // 32 cells per instruction
+    UPDATE_KERNEL_AVX512 = 3,    // 64 cells per instruction, needs AVX-512BW
+    UPDATE_KERNEL_BITPACKED = 4, // packs 64 cells into a word and counts the neighbors with bitwise adders
+    UPDATE_KERNEL_COUNT = 5,
+    UPDATE_KERNEL_AUTO = UPDATE_KERNEL_COUNT // benchmark the supported kernels and take the fastest
+};
+
+/**
+ * Computes the next state of the columns first_column to last_column - 1 of one row.
+ * Cells outside of the row are dead, rows outside of the grid are passed as a row of dead cells
+ *
+ * @param above The row above, read only
+ * @param row The row to update, read only
+ * @param below The row below, read only
+ * @param next The row the next generation is written to
+ * @param width The width of the rows
+ * @param first_column The first column to update
+ * @param last_column The column after the last column to update
+ */
+typedef void (*UpdateRowFunction)(const unsigned char* above, const unsigned char* row, const unsigned char* below, unsigned char* next, int width, int first_column, int last_column);
+
+/**
+ * An entry of the kernel registry
+ *
+ * @param name The name used by --kernel
+ * @param isSupported Checks the CPU features the kernel needs, NULL if it runs everywhere
+ * @param updateRow The kernel, NULL if it was not compiled for this architecture
+ */
+struct UpdateKernel {
+    const char* name;
+    bool (*isSupported)(void);
+    UpdateRowFunction updateRow;
+};
+typedef struct UpdateKernel UpdateKernel;
+
+/**
+ * The registry, indexed by UpdateKernelId. Defined next to the kernels in update_kernels.c
+ */
+extern const UpdateKernel updateKernels[UPDATE_KERNEL_COUNT];
+
+/**
+ * The kernel and column tile width a worker updates its grid with
+ *
+ * @param kernel The UpdateKernelId
+ * @param tile_width The number of columns updated for all rows before moving on to the next columns
+ * @param cells_per_second The throughput measured on the local grid
+ * @param zero_row A row of dead cells for the neighbors of the first and last row of the grid
+ */
+struct KernelChoice {
+    int kernel;
+    int tile_width;
+    double cells_per_second;
+    unsigned char* zero_row;
+};
+typedef struct KernelChoice KernelChoice;
+
+int parseUpdateKernel(const char* name);
+const char* updateKernelName(int kernel);
+bool isUpdateKernelSupported(int kernel);
+
+/**
+ * Chooses the update kernel of the worker. With UPDATE_KERNEL_AUTO every supported kernel runs with every tile width
+ * on a sample of the rows of the local grid and the fastest one is taken. A forced kernel is only benchmarked with the tile widths.
+ * Has to be called after the initial grid is loaded, the grid is not modified
+ *
+ * @param choice The choice to initialize
+ * @param cfg The worker process Config, cfg.kernel is the requested kernel
+ */
+void selectUpdateKernel(KernelChoice* choice, WorkerConfig cfg);
+
+void freeKernelChoice(KernelChoice* choice);
+
+/**
+ * Updates the rows cfg.update_start_row to cfg.update_end_row from cfg.local_grid into cfg.next_grid
+ * with the chosen kernel, column tile by column tile
+ *
+ * @param choice The chosen kernel
+ * @param cfg The worker process Config
+ */
+void updateGridWithKernel(const KernelChoice* choice, WorkerConfig cfg);
@@ -0,0 +1,79 @@
+#include "larger_than_life.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // memset
+
+
+void initLargerThanLife(LargerThanLife* ltl, WorkerConfig cfg) {
+    ltl->column_sums = malloc(cfg.grid_width * sizeof(int));
+    if (ltl->column_sums == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the column sums\n");
+        exit(1);
+    }
+}
+
+void freeLargerThanLife(LargerThanLife* ltl) {
+    free(ltl->column_sums);
+    ltl->column_sums = NULL;
+}
+
+
+static void addRow(int* column_sums, const unsigned char* row, int width, int sign) {
+    for (int j = 0; j < width; j++) {
+        column_sums[j] += sign * row[j];
+    }
+}
+
+
+void updateGridLargerThanLife(LargerThanLife* ltl, WorkerConfig cfg) {
+    const LifeRule rule = cfg.rule;
+    const int radius = rule.radius;
+    const int width = cfg.grid_width;
+    int* column_sums = ltl->column_sums;
+    // the ghost rows reach radius rows beyond the updated rows, further rows are outside of the grid
+    assert(cfg.update_start_row == 0 || cfg.update_start_row >= radius);
+    assert(cfg.update_end_row == cfg.num_rows - 1 || cfg.num_rows - 1 - cfg.update_end_row >= radius);
+
+    memset(column_sums, 0, width * sizeof(int));
+    int first = cfg.update_start_row - radius > 0 ? cfg.update_start_row - radius : 0;
+    int last = cfg.update_start_row + radius < cfg.num_rows - 1 ? cfg.update_start_row + radius : cfg.num_rows - 1;
+    for (int r = first; r <= last; r++) {
+        addRow(column_sums, cfg.local_grid[r], width, 1);
+    }
+
+    for (int i = cfg.update_start_row; i <= cfg.update_end_row; i++) {
+        if (i > cfg.update_start_row) {
+            // move the rows of the column sums down by one
+            if (i + radius < cfg.num_rows) {
+                addRow(column_sums, cfg.local_grid[i + radius], width, 1);
+            }
+            if (i - radius - 1 >= 0) {
+                addRow(column_sums, cfg.local_grid[i - radius - 1], width, -1);
+            }
+        }
+
+        const unsigned char* row = cfg.local_grid[i];
+        unsigned char* next = cfg.next_grid[i];
+        int box = 0;
+        for (int j = 0; j <= radius && j < width; j++) {
+            box += column_sums[j];
+        }
+        for (int j = 0; j < width; j++) {
+            int count = rule.middle ? box : box - row[j];
+            if (row[j]) {
+                next[j] = count >= rule.survive_min && count <= rule.survive_max;
+            } else {
+                next[j] = count >= rule.birth_min && count <= rule.birth_max;
+            }
+            // move the box right by one column
+            if (j + radius + 1 < width) {
+                box += column_sums[j + radius + 1];
+            }
+            if (j - radius >= 0) {
+                box -= column_sums[j - radius];
+            }
+        }
+    }
+}
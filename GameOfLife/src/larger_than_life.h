@@ -0,0 +1,27 @@
+#pragma once
+
+#include "game_of_life_mpi.h"
+
+/**
+ * Workspace of the Larger than Life update
+ *
+ * @param column_sums Alive cells per column in the 2 * radius + 1 rows around the updated row
+ */
+struct LargerThanLife {
+    int* column_sums;
+};
+typedef struct LargerThanLife LargerThanLife;
+
+void initLargerThanLife(LargerThanLife* ltl, WorkerConfig cfg);
+
+void freeLargerThanLife(LargerThanLife* ltl);
+
+/**
+ * Updates the rows cfg.update_start_row to cfg.update_end_row from cfg.local_grid into cfg.next_grid with cfg.rule.
+ * The column sums slide down one row and the box sum slides along the row, so a cell costs O(1) for every radius.
+ * Needs cfg.halo_depth >= cfg.rule.radius ghost rows
+ *
+ * @param ltl The workspace
+ * @param cfg The worker process Config
+ */
+void updateGridLargerThanLife(LargerThanLife* ltl, WorkerConfig cfg);
@@ -0,0 +1,333 @@
+#include "life3d.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // memset, memcpy
+
+#include "image_creation.h"
+#include "memory_placement.h"
+#include "perf_counters.h"
+#include "utils.h"
+#include "utils_grid.h"
+
+// share of living voxels in the random initial cube
+#define LIFE3D_DENSITY 0.2
+
+
+/**
+ * Splits extent voxels over parts like the rows of the 2D grid, the first ones get one more
+ */
+static void splitExtent(int extent, int parts, int coord, int* start, int* count) {
+    int base = extent / parts;
+    int remainder = extent % parts;
+    *start = coord * base + (coord < remainder ? coord : remainder);
+    *count = base + (coord < remainder ? 1 : 0);
+}
+
+
+static size_t volumeSize(const Volume3d* volume) {
+    return (size_t)(volume->nz + 2) * (volume->ny + 2) * (volume->nx + 2);
+}
+
+
+static size_t voxelIndex(const Volume3d* volume, int z, int y, int x) {
+    return ((size_t)z * (volume->ny + 2) + y) * (volume->nx + 2) + x;
+}
+
+
+/**
+ * Creates the subarray types of the exchange in dimension d. The dimensions that are exchanged before d (the higher ones)
+ * include their ghost layers, so the edges and corners are forwarded
+ */
+static void createFaceTypes(Volume3d* volume, int d) {
+    int sizes[3] = {volume->nz + 2, volume->ny + 2, volume->nx + 2};
+    int subsizes[3], starts[3];
+    for (int k = 0; k < 3; k++) {
+        subsizes[k] = k > d ? sizes[k] : sizes[k] - 2;
+        starts[k] = k > d ? 0 : 1;
+    }
+    subsizes[d] = 1;
+    // the first and last owned layer are sent, the ghost layers in front of and behind them received
+    int positions[2][2] = {{1, sizes[d] - 2}, {0, sizes[d] - 1}};
+    for (int side = 0; side < 2; side++) {
+        starts[d] = positions[0][side];
+        MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, MPI_UNSIGNED_CHAR, &volume->send_types[d][side]);
+        MPI_Type_commit(&volume->send_types[d][side]);
+        starts[d] = positions[1][side];
+        MPI_Type_create_subarray(3, sizes, subsizes, starts, MPI_ORDER_C, MPI_UNSIGNED_CHAR, &volume->recv_types[d][side]);
+        MPI_Type_commit(&volume->recv_types[d][side]);
+    }
+}
+
+
+void initVolume3d(Volume3d* volume, WorkerConfig cfg, MPI_Comm worker_comm) {
+    int size = cfg.grid_width;
+    int workers;
+    MPI_Comm_size(worker_comm, &workers);
+    int dims[3] = {0, 0, 0}, periods[3] = {0, 0, 0}, coords[3];
+    MPI_Dims_create(workers, 3, dims);
+    // no reorder, the rank in cart_comm stays the rank in worker_comm
+    MPI_Cart_create(worker_comm, 3, dims, periods, 0, &volume->cart_comm);
+    int cart_rank;
+    MPI_Comm_rank(volume->cart_comm, &cart_rank);
+    MPI_Cart_coords(volume->cart_comm, cart_rank, 3, coords);
+    splitExtent(size, dims[0], coords[0], &volume->z0, &volume->nz);
+    splitExtent(size, dims[1], coords[1], &volume->y0, &volume->ny);
+    splitExtent(size, dims[2], coords[2], &volume->x0, &volume->nx);
+    for (int d = 0; d < 3; d++) {
+        MPI_Cart_shift(volume->cart_comm, d, 1, &volume->neighbors[d][0], &volume->neighbors[d][1]);
+        createFaceTypes(volume, d);
+    }
+
+    // zeroed, the ghost layers at the border of the cube stay dead
+    size_t bytes = volumeSize(volume);
+    volume->cells[0] = allocateGridMemory(bytes, cfg.page_mode, &volume->page_mode[0]);
+    volume->cells[1] = allocateGridMemory(bytes, cfg.page_mode, &volume->page_mode[1]);
+    volume->current = 0;
+    volume->row_sums = malloc((size_t)(volume->ny + 2) * volume->nx);
+    for (int i = 0; i < 3; i++) {
+        volume->plane_sums[i] = malloc((size_t)volume->ny * volume->nx);
+    }
+    if (volume->row_sums == NULL || volume->plane_sums[0] == NULL || volume->plane_sums[1] == NULL || volume->plane_sums[2] == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the neighbor sums\n");
+        exit(1);
+    }
+    volume->bytes_sent = 0;
+
+    unsigned char* cells = volume->cells[0];
+    for (int z = 1; z <= volume->nz; z++) {
+        for (int y = 1; y <= volume->ny; y++) {
+            long long row = ((long long)(volume->z0 + z - 1) * size + volume->y0 + y - 1) * size + volume->x0 - 1;
+            for (int x = 1; x <= volume->nx; x++) {
+                cells[voxelIndex(volume, z, y, x)] = hashedRandomCell(cfg.seed, row + x, LIFE3D_DENSITY);
+            }
+        }
+    }
+}
+
+
+void freeVolume3d(Volume3d* volume) {
+    size_t bytes = volumeSize(volume);
+    freeGridMemory(volume->cells[0], bytes, volume->page_mode[0]);
+    freeGridMemory(volume->cells[1], bytes, volume->page_mode[1]);
+    free(volume->row_sums);
+    for (int i = 0; i < 3; i++) {
+        free(volume->plane_sums[i]);
+    }
+    for (int d = 0; d < 3; d++) {
+        for (int side = 0; side < 2; side++) {
+            MPI_Type_free(&volume->send_types[d][side]);
+            MPI_Type_free(&volume->recv_types[d][side]);
+        }
+    }
+    MPI_Comm_free(&volume->cart_comm);
+}
+
+
+void exchangeVolumeHalos(Volume3d* volume) {
+    unsigned char* cells = volume->cells[volume->current];
+    for (int d = 2; d >= 0; d--) {
+        int lower = volume->neighbors[d][0];
+        int upper = volume->neighbors[d][1];
+        // the lower face goes down while the upper ghost layer comes from above, then the other way around
+        MPI_Sendrecv(cells, 1, volume->send_types[d][0], lower, 2 * d,
+            cells, 1, volume->recv_types[d][1], upper, 2 * d, volume->cart_comm, MPI_STATUS_IGNORE);
+        MPI_Sendrecv(cells, 1, volume->send_types[d][1], upper, 2 * d + 1,
+            cells, 1, volume->recv_types[d][0], lower, 2 * d + 1, volume->cart_comm, MPI_STATUS_IGNORE);
+
+        int face;
+        MPI_Type_size(volume->send_types[d][0], &face);
+        volume->bytes_sent += (long long)face * ((lower != MPI_PROC_NULL) + (upper != MPI_PROC_NULL));
+    }
+}
+
+
+/**
+ * Sums every voxel of a plane with its 8 neighbors in the plane: 3 voxels of a row, then 3 of these row sums
+ */
+static void sumPlane(const Volume3d* volume, const unsigned char* plane, unsigned char* row_sums, unsigned char* plane_sum) {
+    int nx = volume->nx;
+    int stride = nx + 2;
+    for (int y = 0; y < volume->ny + 2; y++) {
+        const unsigned char* row = plane + (size_t)y * stride;
+        unsigned char* sum = row_sums + (size_t)y * nx;
+        for (int x = 0; x < nx; x++) {
+            sum[x] = row[x] + row[x + 1] + row[x + 2];
+        }
+    }
+    for (int y = 0; y < volume->ny; y++) {
+        const unsigned char* above = row_sums + (size_t)y * nx;
+        unsigned char* sum = plane_sum + (size_t)y * nx;
+        for (int x = 0; x < nx; x++) {
+            sum[x] = above[x] + above[x + nx] + above[x + 2 * nx];
+        }
+    }
+}
+
+
+void updateVolume3d(Volume3d* volume, const LifeRule* rule) {
+    const unsigned char* cells = volume->cells[volume->current];
+    unsigned char* next = volume->cells[1 - volume->current];
+    size_t plane_size = (size_t)(volume->ny + 2) * (volume->nx + 2);
+    int nx = volume->nx;
+    // the plane sums of z - 1, z and z + 1 rotate through the three buffers
+    sumPlane(volume, cells, volume->row_sums, volume->plane_sums[0]);
+    sumPlane(volume, cells + plane_size, volume->row_sums, volume->plane_sums[1]);
+    for (int z = 1; z <= volume->nz; z++) {
+        sumPlane(volume, cells + (z + 1) * plane_size, volume->row_sums, volume->plane_sums[(z + 1) % 3]);
+        const unsigned char* below = volume->plane_sums[(z - 1) % 3];
+        const unsigned char* middle = volume->plane_sums[z % 3];
+        const unsigned char* above = volume->plane_sums[(z + 1) % 3];
+        for (int y = 1; y <= volume->ny; y++) {
+            size_t offset = (size_t)(y - 1) * nx;
+            const unsigned char* row = cells + voxelIndex(volume, z, y, 1);
+            unsigned char* next_row = next + voxelIndex(volume, z, y, 1);
+            for (int x = 0; x < nx; x++) {
+                int alive = row[x];
+                int count = below[offset + x] + middle[offset + x] + above[offset + x] - (rule->middle ? 0 : alive);
+                next_row[x] = alive ? count >= rule->survive_min && count <= rule->survive_max
+                                    : count >= rule->birth_min && count <= rule->birth_max;
+            }
+        }
+    }
+    volume->current = 1 - volume->current;
+}
+
+
+void writeVolumeImages(const Volume3d* volume, int size, const char* label, int iterations) {
+    // the slice in the first size rows, the projection in the second, the parts of the workers are combined with MPI_MAX
+    size_t image_size = (size_t)size * size;
+    unsigned char* images = calloc(2 * image_size, 1);
+    unsigned char* result = NULL;
+    long long population = 0, total_population = 0;
+    if (images == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the images\n");
+        exit(1);
+    }
+    if (volume != NULL) {
+        const unsigned char* cells = volume->cells[volume->current];
+        int slice = size / 2;
+        for (int z = 1; z <= volume->nz; z++) {
+            bool in_slice = volume->z0 + z - 1 == slice;
+            for (int y = 1; y <= volume->ny; y++) {
+                const unsigned char* row = cells + voxelIndex(volume, z, y, 1);
+                size_t pixel = (size_t)(volume->y0 + y - 1) * size + volume->x0;
+                for (int x = 0; x < volume->nx; x++) {
+                    images[image_size + pixel + x] |= row[x];
+                    population += row[x];
+                }
+                if (in_slice) {
+                    memcpy(images + pixel, row, volume->nx);
+                }
+            }
+        }
+    } else {
+        result = malloc(2 * image_size);
+        if (result == NULL) {
+            fprintf(stderr, "Failed to allocate memory for the images\n");
+            exit(1);
+        }
+    }
+    MPI_Reduce(images, result, 2 * image_size, MPI_UNSIGNED_CHAR, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&population, &total_population, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    free(images);
+    if (result == NULL) {
+        return;
+    }
+
+    char file_name_buffer[80];
+    unsigned char** view = createGridView(result, 2 * size, size);
+    printf("Master process: %s cube has %lld living voxels\n", label, total_population);
+    snprintf(file_name_buffer, 80, "mpi_%s_slice-%d-%dx%dx%d.jpg", label, iterations, size, size, size);
+    write_jpeg_file(file_name_buffer, view, size, size);
+    snprintf(file_name_buffer, 80, "mpi_%s_projection-%d-%dx%dx%d.jpg", label, iterations, size, size, size);
+    write_jpeg_file(file_name_buffer, view + size, size, size);
+    freeGridView(view);
+    free(result);
+}
+
+
+void runLife3dMaster(const GameConfig* cfg) {
+    double start_time = MPI_Wtime();
+    int world_size;
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    // the workers partition the cube with the same MPI_Dims_create, every part needs at least one voxel per dimension
+    int dims[3] = {0, 0, 0};
+    MPI_Dims_create(world_size - 1, 3, dims);
+    printf("Master process: partitioning the %d^3 cube into %d x %d x %d parts\n", cfg->width, dims[0], dims[1], dims[2]);
+    if (dims[0] > cfg->width || dims[1] > cfg->width || dims[2] > cfg->width) {
+        fprintf(stderr, "Error: the %d^3 cube can not be split into %d x %d x %d parts. Use fewer processes\n", cfg->width, dims[0], dims[1], dims[2]);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    PerfCounters counters;
+    openPerfCounters(&counters, cfg->counters);
+    startCounterPhase(&counters, COUNTER_PHASE_IO);
+    writeVolumeImages(NULL, cfg->width, "initial", cfg->total_iterations);
+    writeVolumeImages(NULL, cfg->width, "result", cfg->total_iterations);
+    stopCounterPhase(&counters);
+    if (cfg->counters) {
+        long long cells[COUNTER_PHASE_COUNT] = {0, 0, 4LL * cfg->width * cfg->width};
+        reportPerfCounters(&counters, MPI_COMM_SELF, cells, "Master process");
+    }
+    closePerfCounters(&counters);
+
+    printf("Master process time: %f seconds\n", MPI_Wtime() - start_time);
+}
+
+
+void runLife3dWorker(WorkerConfig cfg, MPI_Comm worker_comm) {
+    double start_time = MPI_Wtime();
+    int size = cfg.grid_width;
+    WorkerPlacement placement;
+    placeWorker(&placement, worker_comm, cfg.pin); // before the volume is touched
+    Volume3d volume;
+    initVolume3d(&volume, cfg, worker_comm);
+    PerfCounters counters;
+    openPerfCounters(&counters, cfg.counters);
+    printf("Worker process %2d: cpu %d, numa node %d, %s, %s and %s pages for %.1f MB of volume, voxels %d..%d x %d..%d x %d..%d\n", cfg.world_rank,
+        placement.cpu, placement.numa_node, placement.pinned ? "pinned" : "not pinned", pageModeName(volume.page_mode[0]), pageModeName(volume.page_mode[1]),
+        2.0 * volumeSize(&volume) / (1024 * 1024), volume.z0, volume.z0 + volume.nz - 1, volume.y0, volume.y0 + volume.ny - 1,
+        volume.x0, volume.x0 + volume.nx - 1);
+
+    startCounterPhase(&counters, COUNTER_PHASE_IO);
+    writeVolumeImages(&volume, size, "initial", cfg.total_iterations);
+    stopCounterPhase(&counters);
+    exchangeVolumeHalos(&volume);
+    volume.bytes_sent = 0;
+
+    MPI_Barrier(worker_comm); // Barrier operation for workers only, to make them start at the same time
+
+    double update_time = 0, halo_time = 0;
+    for (int i = 0; i < cfg.total_iterations; i++) {
+        double phase_start = MPI_Wtime();
+        startCounterPhase(&counters, COUNTER_PHASE_UPDATE);
+        updateVolume3d(&volume, &cfg.rule);
+        stopCounterPhase(&counters);
+        double phase_mid = MPI_Wtime();
+        startCounterPhase(&counters, COUNTER_PHASE_HALO);
+        exchangeVolumeHalos(&volume);
+        stopCounterPhase(&counters);
+        update_time += phase_mid - phase_start;
+        halo_time += MPI_Wtime() - phase_mid;
+    }
+
+    startCounterPhase(&counters, COUNTER_PHASE_IO);
+    writeVolumeImages(&volume, size, "result", cfg.total_iterations);
+    stopCounterPhase(&counters);
+
+    double end_time = MPI_Wtime();
+    printf("Worker process %2d time: %f seconds timePerIteration: %f ms update: %f ms halo (cart 3d): %f ms %.1f bytes sent\n", cfg.world_rank,
+        end_time - start_time, (end_time - start_time) / cfg.total_iterations * 1000, update_time / cfg.total_iterations * 1000,
+        halo_time / cfg.total_iterations * 1000, (double)volume.bytes_sent / cfg.total_iterations);
+
+    if (cfg.counters) {
+        // voxels updated, ghost voxels received, and voxels sent to the two images
+        long long owned_voxels = (long long)volume.nz * volume.ny * volume.nx;
+        long long cells[COUNTER_PHASE_COUNT] = {owned_voxels * cfg.total_iterations,
+            ((long long)volumeSize(&volume) - owned_voxels) * cfg.total_iterations, 2 * owned_voxels};
+        reportPerfCounters(&counters, worker_comm, cells, "Workers");
+    }
+    closePerfCounters(&counters);
+    freeVolume3d(&volume);
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <mpi.h>
+
+#include "arg_parser.h"
+#include "game_of_life_mpi.h"
+
+// largest edge length of the cube, the volume grows with its third power
+#define LIFE3D_MAX_SIZE 1024
+
+/**
+ * The part of the cube a worker updates, as a contiguous volume with one ghost layer on every side
+ *
+ * @param nz The number of owned planes
+ * @param ny The number of owned rows per plane
+ * @param nx The number of owned voxels per row
+ * @param z0 The global index of the first owned plane
+ * @param y0 The global index of the first owned row
+ * @param x0 The global index of the first owned voxel of a row
+ * @param cells The current and the next generation, (nz + 2) * (ny + 2) * (nx + 2) voxels each
+ * @param current The index of the current generation in cells
+ * @param cart_comm The 3D cartesian communicator of the workers
+ * @param neighbors The lower and upper neighbor in z, y and x, MPI_PROC_NULL at the border of the cube
+ * @param send_types The subarrays of the faces sent to the lower and upper neighbor, per dimension
+ * @param recv_types The subarrays of the ghost faces received from the lower and upper neighbor, per dimension
+ * @param row_sums Sums of 3 voxels along x of the (ny + 2) rows of a plane
+ * @param plane_sums Sums of 3 x 3 voxels of the last three planes, ny * nx each
+ * @param page_mode The PageMode each of the two generations got, they are freed with it
+ * @param bytes_sent Voxels sent to the neighbors over all generations
+ */
+struct Volume3d {
+    int nz, ny, nx;
+    int z0, y0, x0;
+    unsigned char* cells[2];
+    int current;
+
+    MPI_Comm cart_comm;
+    int neighbors[3][2];
+    MPI_Datatype send_types[3][2];
+    MPI_Datatype recv_types[3][2];
+
+    unsigned char* row_sums;
+    unsigned char* plane_sums[3];
+
+    int page_mode[2];
+    long long bytes_sent;
+};
+typedef struct Volume3d Volume3d;
+
+/**
+ * Partitions the cube over the workers with MPI_Cart_create, allocates the volume of this worker
+ * and fills it with random voxels. The voxels only depend on the seed and their global position,
+ * so every partitioning starts from the same cube
+ *
+ * @param volume The volume to initialize
+ * @param cfg The worker process Config, grid_width is the edge length of the cube
+ * @param worker_comm The communicator of all workers
+ */
+void initVolume3d(Volume3d* volume, WorkerConfig cfg, MPI_Comm worker_comm);
+
+void freeVolume3d(Volume3d* volume);
+
+/**
+ * Fills the ghost layers with the faces, edges and corners of the neighbors. The exchange runs in x, then y, then z,
+ * and every phase forwards the ghost voxels of the previous ones, so the 26 neighbors are reached with 6 messages
+ */
+void exchangeVolumeHalos(Volume3d* volume);
+
+/**
+ * Computes the next generation of the owned voxels with the rule, counting the 26 neighbors with separable sums:
+ * 3 voxels along x, then 3 rows along y, then 3 planes along z
+ */
+void updateVolume3d(Volume3d* volume, const LifeRule* rule);
+
+/**
+ * Collective over MPI_COMM_WORLD: the main process receives the middle plane of the cube and
+ * the projection of all planes along z and writes them as jpeg images
+ *
+ * @param volume The volume of the worker, NULL on the main process
+ * @param size The edge length of the cube
+ * @param label Part of the file names
+ * @param iterations Part of the file names
+ */
+void writeVolumeImages(const Volume3d* volume, int size, const char* label, int iterations);
+
+/**
+ * Runs the 3D game on the main process: the workers partition the cube themselves, only the images are collected
+ */
+void runLife3dMaster(const GameConfig* cfg);
+
+/**
+ * Runs the 3D game on a worker, called with the config from distributeAndSendConfig
+ */
+void runLife3dWorker(WorkerConfig cfg, MPI_Comm worker_comm);
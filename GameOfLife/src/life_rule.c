@@ -0,0 +1,52 @@
+#include "life_rule.h"
+
+#include <ctype.h> // isdigit
+#include <stdio.h> // sscanf, snprintf
+#include <string.h> // strcmp, strlen
+
+
+LifeRule conwayRule(void) {
+    LifeRule rule = {.radius = 1, .states = 0, .middle = 0, .survive_min = 2, .survive_max = 3, .birth_min = 3, .birth_max = 3};
+    return rule;
+}
+
+bool isConwayRule(const LifeRule* rule) {
+    LifeRule conway = conwayRule();
+    return rule->radius == conway.radius && rule->middle == conway.middle
+        && rule->survive_min == conway.survive_min && rule->survive_max == conway.survive_max
+        && rule->birth_min == conway.birth_min && rule->birth_max == conway.birth_max;
+}
+
+
+bool parseLifeRule(const char* text, LifeRule* rule) {
+    if (strcmp(text, "life") == 0) {
+        *rule = conwayRule();
+        return true;
+    }
+    // the 3D rules of Bays: the bounds to survive, then the bounds to be born
+    if (strlen(text) == 4 && isdigit((unsigned char)text[0]) && isdigit((unsigned char)text[1]) && isdigit((unsigned char)text[2]) && isdigit((unsigned char)text[3])) {
+        LifeRule bays = {.radius = 1, .states = 0, .middle = 0, .survive_min = text[0] - '0', .survive_max = text[1] - '0',
+            .birth_min = text[2] - '0', .birth_max = text[3] - '0'};
+        *rule = bays;
+        return rule->survive_min <= rule->survive_max && rule->birth_min <= rule->birth_max;
+    }
+    int length = 0;
+    int matched = sscanf(text, "R%d,C%d,M%d,S%d..%d,B%d..%d%n", &rule->radius, &rule->states, &rule->middle,
+        &rule->survive_min, &rule->survive_max, &rule->birth_min, &rule->birth_max, &length);
+    if (matched != LIFE_RULE_FIELD_COUNT || text[length] != '\0') {
+        return false;
+    }
+
+    // the upper bounds depend on the dimensions, parseArguments checks them
+    return rule->radius >= 1 && rule->radius <= 500
+        && (rule->states == 0 || rule->states == 2) // more states decay over several generations
+        && (rule->middle == 0 || rule->middle == 1)
+        && rule->survive_min >= 0 && rule->survive_min <= rule->survive_max
+        && rule->birth_min >= 0 && rule->birth_min <= rule->birth_max;
+}
+
+
+void formatLifeRule(const LifeRule* rule, char* buffer, size_t size) {
+    snprintf(buffer, size, "R%d,C%d,M%d,S%d..%d,B%d..%d", rule->radius, rule->states, rule->middle,
+        rule->survive_min, rule->survive_max, rule->birth_min, rule->birth_max);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// number of int fields of LifeRule, it is sent as one block of MPI_INT
+#define LIFE_RULE_FIELD_COUNT 7
+
+/**
+ * A Larger than Life rule in the notation R<radius>,C<states>,M<middle>,S<min>..<max>,B<min>..<max>.
+ * The neighborhood is the (2 * radius + 1)^2 box around a cell, Conway's Game of Life is R1,C0,M0,S2..3,B3..3
+ *
+ * @param radius The radius of the box
+ * @param states The number of states, only 0 and 2 (two states) are supported
+ * @param middle 1 if the cell itself is counted
+ * @param survive_min An alive cell survives with survive_min to survive_max alive cells in its neighborhood
+ * @param survive_max
+ * @param birth_min A dead cell is born with birth_min to birth_max alive cells in its neighborhood
+ * @param birth_max
+ */
+struct LifeRule {
+    int radius;
+    int states;
+    int middle;
+    int survive_min;
+    int survive_max;
+    int birth_min;
+    int birth_max;
+};
+typedef struct LifeRule LifeRule;
+
+LifeRule conwayRule(void);
+
+bool isConwayRule(const LifeRule* rule);
+
+/**
+ * Parses a rule in the Larger than Life notation, "life" is Conway's Game of Life.
+ * 4 digits are a 3D rule of Bays, 4555 is R1,C0,M0,S4..5,B5..5. The upper bounds are not checked against the neighborhood
+ *
+ * @param text The rule
+ * @param rule The parsed rule
+ * @return false if the rule is invalid or not supported
+ */
+bool parseLifeRule(const char* text, LifeRule* rule);
+
+void formatLifeRule(const LifeRule* rule, char* buffer, size_t size);
@@ -6,16 +6,29 @@
 #include <scorep/SCOREP_User.h>
 
 
+#include "census.h"
+#include "dataflow.h"
 #include "game_of_life_mpi.h"
+#include "halo_exchange.h"
+#include "history_store.h"
+#include "kernel_registry.h"
+#include "larger_than_life.h"
+#include "life3d.h"
+#include "memory_placement.h"
+#include "out_of_core.h"
+#include "perf_counters.h"
 #include "arg_parser.h"
 #include "image_creation.h"
+#include "pattern_loader.h"
+#include "server.h"
+#include "sparse_universe.h"
 #include "utils.h"
 #include "utils_grid.h"
 
 
 /*
 Optimizations
-- Use a 2 bit to store the next state of the cell
+- Use a 2 bit to store the next state of the cell (replaced by two grid buffers)
 - what to use this for?
     - execute 100000 random patterns and see which one lives the longest
 - track how many cells live and then skip lines that are all dead and their neighbors too
@@ -24,11 +37,14 @@ Optimizations
 */
 
 
+void placePattern(GameConfig* cfg);
 void masterProcess(int argc, char** argv, int world_size);
 void workerProcess(MPI_Comm worker_comm, int world_rank);
 
 int main(int argc, char** argv) {
-    MPI_Init(&argc, &argv);
+    // the dataflow schedule updates with several threads, only the main thread calls MPI
+    int thread_support;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
     int world_rank, world_size;  
     MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
     MPI_Comm_size(MPI_COMM_WORLD, &world_size);
@@ -57,7 +73,9 @@ int main(int argc, char** argv) {
         workerProcess(worker_comm, world_rank);
     }
 
-    MPI_Comm_free(&worker_comm); // Free the communicator for worker processes
+    if (worker_comm != MPI_COMM_NULL) {
+        MPI_Comm_free(&worker_comm); // Free the communicator for worker processes
+    }
 
     // free custom MPI type
     MPI_Type_free(&workerConfigType);
@@ -68,46 +86,157 @@ int main(int argc, char** argv) {
     
 }
 
+/**
+ * Reads only the size of the pattern, every worker parses its own rows
+ */
+void placePattern(GameConfig* cfg) {
+    Pattern pattern;
+    int error = openPattern(cfg->pattern_file, &pattern);
+    if (error != PATTERN_OK) {
+        fprintf(stderr, "Error: cannot load the pattern %s: %s\n", cfg->pattern_file, patternErrorName(error));
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (!cfg->pattern_offset_set) {
+        cfg->pattern_offset_y = (cfg->height - pattern.height) / 2;
+        cfg->pattern_offset_x = (cfg->width - pattern.width) / 2;
+    }
+    printf("Master process: placing %s pattern %dx%d at %d,%d\n", patternFormatName(pattern.format), pattern.width, pattern.height, cfg->pattern_offset_y, cfg->pattern_offset_x);
+    if (cfg->pattern_offset_y < 0 || cfg->pattern_offset_x < 0 || cfg->pattern_offset_y + pattern.height > cfg->height || cfg->pattern_offset_x + pattern.width > cfg->width) {
+        printf("Warning: the pattern does not fit into the grid and is clipped\n");
+    }
+    closePattern(&pattern);
+}
+
 void masterProcess(int argc, char** argv, int world_size) {
     debugPrint("Master process: Starting...\n");
     GameConfig cfg = parseArguments(argc, argv);
     double start_time, end_time;
     start_time = MPI_Wtime();
 
-    unsigned char** grid = createGrid(cfg.height, cfg.width);
+    // contiguous, so the parts can be scattered and gathered as blocks
+    unsigned char* grid_block = NULL;
+    unsigned char** grid = NULL;
     char file_name_buffer[80];
 
-    printf("Master process: initializing grid\n");
-    initializeGridRandom(grid, cfg.height, cfg.width, 0.3);
-    //initializeGridModulo(grid, height, width, 3);
-    //initializeGridZero(grid, height, width);
+    if (cfg.dimensions == 3) {
+        // the workers create their parts of the cube themselves
+        WorkerConfig workerConfigs[world_size - 1];
+        distributeAndSendConfig(world_size, &cfg, workerConfigs);
+        runLife3dMaster(&cfg);
+        return;
+    }
+    if (cfg.serve != NULL) {
+        // the workers wait for the jobs, the config only carries the options every job shares
+        WorkerConfig workerConfigs[world_size - 1];
+        distributeAndSendConfig(world_size, &cfg, workerConfigs);
+        runServerMaster(&cfg, world_size);
+        return;
+    }
+    if (cfg.universe == UNIVERSE_SPARSE) {
+        // the universe has no size to center the pattern in, without an offset it starts at 0,0
+        if (cfg.pattern_file != NULL && !cfg.pattern_offset_set) {
+            cfg.pattern_offset_y = 0;
+            cfg.pattern_offset_x = 0;
+        }
+        WorkerConfig workerConfigs[world_size - 1];
+        distributeAndSendConfig(world_size, &cfg, workerConfigs);
+        runSparseMaster(&cfg);
+        return;
+    }
 
-    printf("Master process: Grid generated\n");
+    if (cfg.pattern_file != NULL) {
+        placePattern(&cfg);
+    } else if (cfg.replay < 0 && cfg.out_of_core == NULL) { // out-of-core workers seed their own rows, the grid may not fit here
+        grid_block = createGridSingleBlock(cfg.height, cfg.width);
+        grid = createGridView(grid_block, cfg.height, cfg.width);
+        printf("Master process: initializing grid\n");
+        if (cfg.seed_set) {
+            initializeGridHashed(grid, cfg.height, cfg.width, cfg.seed, 0.3); // reproducible
+        } else {
+            initializeGridRandom(grid, cfg.height, cfg.width, 0.3);
+        }
+        //initializeGridModulo(grid, height, width, 3);
+        //initializeGridZero(grid, height, width);
+
+        printf("Master process: Grid generated\n");
+    }
     
     WorkerConfig workerConfigs[world_size - 1];
-    distributeAndSendConfig(world_size, cfg.height, cfg.width, cfg.total_iterations, workerConfigs);
+    distributeAndSendConfig(world_size, &cfg, workerConfigs);
     
     printf("Master process: Sent all Configs\n");
-    sendGridPartsToWorkers(grid, workerConfigs, world_size-1);
-    printf("Master process: Sent all Grids\n");
-
-    debugPrint("Master process: Writing initial image to 'mpi_initial_grid.jpg'\n");
-
-    
-    
-    snprintf(file_name_buffer, 80, "mpi_initial_grid-%d-%dx%d.jpg", cfg.total_iterations, cfg.width, cfg.height);
-    write_jpeg_file(file_name_buffer, grid, cfg.width, cfg.height);
-
-    receiveGridParts(workerConfigs, grid, cfg.height, cfg.width, world_size);
-    debugPrint("Master process: Received total grid from workers\n");
-
+    PerfCounters counters;
+    openPerfCounters(&counters, cfg.counters);
+    startCounterPhase(&counters, COUNTER_PHASE_IO);
+    if (grid != NULL) {
+        sendGridPartsToWorkers(grid, workerConfigs, cfg.height, cfg.width, world_size, cfg.pack_transfers);
+        printf("Master process: Sent all Grids\n");
+
+        debugPrint("Master process: Writing initial image to 'mpi_initial_grid.jpg'\n");
+        snprintf(file_name_buffer, 80, "mpi_initial_grid-%d-%dx%d.jpg", cfg.total_iterations, cfg.width, cfg.height);
+        write_jpeg_file(file_name_buffer, grid, cfg.width, cfg.height);
+    }
 
-    debugPrint("Master process: Writing image to 'mpi_result_grid.jpg'\n");
-    snprintf(file_name_buffer, 80, "mpi_result_grid-%d-%dx%d.jpg", cfg.total_iterations, cfg.height, cfg.width);
-    write_jpeg_file(file_name_buffer, grid, cfg.width, cfg.height);
-    
+    CensusLog census;
+    char census_file_name[80];
+    if (cfg.census > 0) {
+        snprintf(census_file_name, 80, CENSUS_FILE_NAME, cfg.total_iterations, cfg.width, cfg.height);
+        openCensusLog(&census, census_file_name, cfg.census, cfg.total_iterations, world_size);
+    }
+    long long received_cells;
+    if (hasGridRegion(&cfg.region)) {
+        // only the rectangle, from the workers that own its rows
+        int rows = regionRows(&cfg.region), columns = regionColumns(&cfg.region);
+        unsigned char* region_block = createGridSingleBlock(rows, columns);
+        unsigned char** region_cells = createGridView(region_block, rows, columns);
+        int snapshots = 0;
+        int done = 0;
+        do { // a replay of generation 0 has one snapshot too
+            done += regionSnapshotGenerations(&cfg.region, done, cfg.total_iterations);
+            if (cfg.census > 0) {
+                receiveCensuses(&census, done); // the workers take them before the snapshot
+            }
+            receiveRegion(workerConfigs, world_size, &cfg.region, cfg.pack_transfers, region_cells);
+            snprintf(file_name_buffer, 80, "mpi_region-%d-%d,%d-%dx%d.%s", done, cfg.region.row, cfg.region.column, cfg.region.height, cfg.region.width,
+                cfg.region_format == REGION_FORMAT_PBM ? "pbm" : "jpg");
+            writeRegionFile(file_name_buffer, region_cells, &cfg.region, cfg.region_format);
+            snapshots++;
+        } while (done < cfg.total_iterations);
+        printf("Master process: wrote %d snapshots of the %d x %d region\n", snapshots, columns, rows);
+        received_cells = (long long)rows * columns;
+        freeGridView(region_cells);
+        free(region_block);
+    } else {
+        if (cfg.census > 0) {
+            receiveCensuses(&census, cfg.total_iterations);
+        }
+        if (grid == NULL) {
+            // the main process never holds the initial grid of a pattern, only the result
+            grid_block = createGridSingleBlock(cfg.height, cfg.width);
+            grid = createGridView(grid_block, cfg.height, cfg.width);
+        }
+        receiveGridParts(workerConfigs, grid, cfg.height, cfg.width, world_size, cfg.pack_transfers);
+        debugPrint("Master process: Received total grid from workers\n");
+
+        debugPrint("Master process: Writing image to 'mpi_result_grid.jpg'\n");
+        snprintf(file_name_buffer, 80, "mpi_result_grid-%d-%dx%d.jpg", cfg.total_iterations, cfg.height, cfg.width);
+        write_jpeg_file(file_name_buffer, grid, cfg.width, cfg.height);
+        received_cells = (long long)cfg.height * cfg.width;
+    }
+    stopCounterPhase(&counters);
+    if (cfg.census > 0) {
+        printf("Master process: %d censuses in %s, %f ms each joining the objects across the workers\n", census.censuses, census_file_name,
+            census.merge_time / max(census.censuses, 1) * 1000);
+        closeCensusLog(&census);
+    }
+    if (cfg.counters) {
+        long long cells[COUNTER_PHASE_COUNT] = {0, 0, received_cells};
+        reportPerfCounters(&counters, MPI_COMM_SELF, cells, "Master process");
+    }
+    closePerfCounters(&counters);
 
-    freeGrid(grid, cfg.height);
+    freeGridView(grid);
+    free(grid_block);
 
     end_time = MPI_Wtime();
     printf("Master process time: %f seconds\n", end_time - start_time);
@@ -121,20 +250,190 @@ void workerProcess(MPI_Comm worker_comm, int world_rank) {
     
     WorkerConfig cfg = receiveWorkerConfig();
     debugPrint("Rank %d: Received config\n", world_rank);
-    receiveInitialGrid(&cfg);
+    if (cfg.dimensions == 3) {
+        runLife3dWorker(cfg, worker_comm);
+        return;
+    }
+    if (cfg.universe == UNIVERSE_SPARSE) {
+        runSparseWorker(cfg, worker_comm);
+        return;
+    }
+    if (cfg.serve) {
+        runServerWorker(cfg, worker_comm);
+        return;
+    }
+    WorkerPlacement placement;
+    placeWorker(&placement, worker_comm, cfg.pin); // before the grid buffers are touched
+    bool out_of_core = cfg.out_of_core_dir[0] != '\0';
+    HaloExchange halo;
+    OutOfCoreGrid ooc;
+    if (out_of_core) {
+        openOutOfCoreGrid(&ooc, &cfg); // both grid buffers are files
+    } else {
+        initHaloExchange(&halo, &cfg, worker_comm); // allocates both grid buffers
+    }
+    PerfCounters counters;
+    openPerfCounters(&counters, cfg.counters);
+    printf("Worker process %2d: cpu %d, numa node %d, %s, %s pages for %.1f MB of grid\n", world_rank, placement.cpu, placement.numa_node,
+        placement.pinned ? "pinned" : "not pinned", out_of_core ? "file backed" : pageModeName(halo.page_mode), 2.0 * cfg.num_rows * cfg.grid_width / (1024 * 1024));
+    startCounterPhase(&counters, COUNTER_PHASE_IO);
+    bool replay = cfg.replay_generation >= 0;
+    bool region = hasGridRegion(&cfg.region);
+    if (replay) {
+        if (!region || ownsRegionRows(cfg)) { // the other workers have nothing to show
+            rebuildGeneration(&cfg, cfg.replay_generation);
+        }
+    } else if (cfg.pattern_file[0] != '\0') {
+        loadInitialGrid(&cfg);
+    } else if (out_of_core) {
+        seedInitialGrid(&cfg, 0.3);
+    } else {
+        receiveInitialGrid(&cfg);
+    }
+    stopCounterPhase(&counters);
+    // the ghost rows are not part of the initial grid
+    if (out_of_core) {
+        sendandReceiveUpdatedGridRows(cfg);
+    } else {
+        exchangeHaloRows(&halo, cfg);
+        halo.bytes_sent = 0;
+    }
+    // the kernels of the registry compute Conway's rule, other rules use the box sums of Larger than Life
+    bool conway = isConwayRule(&cfg.rule);
+    KernelChoice kernel;
+    LargerThanLife ltl;
+    if (conway) {
+        selectUpdateKernel(&kernel, cfg); // benchmarks on the initial grid
+        printf("Worker process %2d: update kernel %s, tile width %d, %.1f Mcells/s\n", world_rank, updateKernelName(kernel.kernel), kernel.tile_width, kernel.cells_per_second / 1e6);
+    } else {
+        initLargerThanLife(&ltl, cfg);
+    }
+    bool dataflow = cfg.schedule == SCHEDULE_DATAFLOW;
+    int thread_support;
+    MPI_Query_thread(&thread_support);
+    if (dataflow && thread_support < MPI_THREAD_FUNNELED) {
+        fprintf(stderr, "Warning: the MPI library does not support threads, worker %d uses the lockstep schedule\n", world_rank);
+        dataflow = false;
+    }
     debugPrint("Rank %d: Received initial grid. Starting to calculate...\n", world_rank);
 
     MPI_Barrier(worker_comm); // Barrier operation for workers only, to make them start at the same time
 
-    for(int i = 0; i < cfg.total_iterations; i++) {
-        updateGridWithLimit(cfg);
-        sendandReceiveUpdatedGridRows(cfg);
+    // time spent per phase, to compare the halo exchange backends
+    double update_time = 0, halo_time = 0;
+    DataflowStats dataflow_stats = {0, 0, 0, 0};
+    bool history = cfg.history_interval > 0;
+    HistoryRecorder recorder;
+    if (history) {
+        openHistoryRecorder(&recorder, cfg, cfg.history_interval);
+    }
+    const int total_iterations = cfg.total_iterations;
+    int next_snapshot = regionSnapshotGenerations(&cfg.region, 0, total_iterations);
+    bool census = cfg.census_interval > 0;
+    double census_time = 0;
+    int next_census = census ? cfg.census_interval : total_iterations + 1;
+    if (census) {
+        double census_start = MPI_Wtime();
+        takeCensus(cfg); // of the initial grid
+        census_time += MPI_Wtime() - census_start;
+    }
+    // the generations run in chunks up to the next snapshot of the region or census, or one by one for the history.
+    // A replay only rebuilds the grid
+    for (int done = replay ? total_iterations : 0; done < total_iterations;) {
+        cfg.total_iterations = history ? 1 : min(next_snapshot, next_census) - done;
+        if (dataflow) {
+            // the update threads are not counted, the calling thread only drives the halo messages
+            double dataflow_start = MPI_Wtime();
+            startCounterPhase(&counters, COUNTER_PHASE_HALO);
+            DataflowStats chunk_stats;
+            runDataflow(&cfg, &halo, conway ? &kernel : NULL, cfg.threads, &chunk_stats);
+            stopCounterPhase(&counters);
+            update_time += MPI_Wtime() - dataflow_start;
+            dataflow_stats.tile_count = chunk_stats.tile_count;
+            dataflow_stats.tile_rows = chunk_stats.tile_rows;
+            dataflow_stats.max_lead = max(dataflow_stats.max_lead, chunk_stats.max_lead);
+            dataflow_stats.idle_waits += chunk_stats.idle_waits;
+        } else if (out_of_core) {
+            startCounterPhase(&counters, COUNTER_PHASE_UPDATE);
+            runOutOfCore(&ooc, &cfg, conway ? &kernel : NULL, &ltl, &update_time, &halo_time);
+            stopCounterPhase(&counters);
+        } else {
+            runLockstep(&cfg, &halo, conway ? &kernel : NULL, &ltl, &counters, &update_time, &halo_time);
+        }
+        done += cfg.total_iterations;
+        if (history) {
+            recordGeneration(&recorder, cfg);
+        }
+        if (done == next_census) {
+            double census_start = MPI_Wtime();
+            takeCensus(cfg); // before the snapshot of the same generation
+            census_time += MPI_Wtime() - census_start;
+            next_census += cfg.census_interval;
+        }
+        if (done == next_snapshot) {
+            if (region) {
+                startCounterPhase(&counters, COUNTER_PHASE_IO);
+                sendRegionToMain(cfg);
+                stopCounterPhase(&counters);
+            }
+            next_snapshot += regionSnapshotGenerations(&cfg.region, done, total_iterations);
+        }
+        if (dataflow && done < total_iterations) {
+            exchangeHaloRows(&halo, cfg); // the dataflow schedule does not receive the ghost rows of its last generation
+        }
+    }
+    cfg.total_iterations = total_iterations;
+    if (history) {
+        printf("Worker process %2d: history of %d generations, %lld bytes of frames for %lld cells per generation\n", world_rank, recorder.frame_count,
+            recorder.bytes_written, (long long)recorder.length);
+        closeHistoryRecorder(&recorder);
     }
 
-    sendGridToMain(cfg);
-    freeGrid(cfg.local_grid, cfg.num_rows);
+    if (region && replay) {
+        sendRegionToMain(cfg);
+    } else if (!region) {
+        startCounterPhase(&counters, COUNTER_PHASE_IO);
+        sendGridToMain(cfg);
+        stopCounterPhase(&counters);
+    }
+    long long halo_bytes_sent;
+    if (out_of_core) {
+        halo_bytes_sent = ooc.bytes_sent;
+        closeOutOfCoreGrid(&ooc, &cfg);
+    } else {
+        halo_bytes_sent = halo.bytes_sent;
+        freeHaloExchange(&halo, &cfg);
+    }
+    if (conway) {
+        freeKernelChoice(&kernel);
+    } else {
+        freeLargerThanLife(&ltl);
+    }
 
     end_time = MPI_Wtime();
-    double timePerIteration = (end_time - start_time) / cfg.total_iterations;
-    printf("Worker process %2d time: %f seconds timePerIteration: %f ms\n", world_rank, end_time - start_time, timePerIteration*1000);
+    double timePerIteration = (end_time - start_time) / max(cfg.total_iterations, 1);
+    if (dataflow) {
+        printf("Worker process %2d time: %f seconds timePerIteration: %f ms dataflow (%d threads, %d tiles of %d rows): %f ms, up to %d generations between the tiles, %lld idle waits, %.1f bytes sent\n",
+            world_rank, end_time - start_time, timePerIteration*1000, cfg.threads, dataflow_stats.tile_count, dataflow_stats.tile_rows,
+            update_time / cfg.total_iterations * 1000, dataflow_stats.max_lead, dataflow_stats.idle_waits, (double)halo_bytes_sent / cfg.total_iterations);
+    } else {
+        printf("Worker process %2d time: %f seconds timePerIteration: %f ms update: %f ms halo (%s, %s): %f ms %.1f bytes sent\n", world_rank, end_time - start_time, timePerIteration*1000,
+            update_time / cfg.total_iterations * 1000, out_of_core ? "out-of-core sweeps" : haloBackendName(cfg.halo_backend), haloEncodingName(cfg.halo_encoding),
+            halo_time / cfg.total_iterations * 1000, (double)halo_bytes_sent / cfg.total_iterations);
+    }
+    if (census) {
+        freeCensusBuffers();
+        int censuses = total_iterations / cfg.census_interval + 1;
+        printf("Worker process %2d: %d censuses, %f ms each, %.2f%% of the update time\n", world_rank, censuses, census_time / censuses * 1000,
+            update_time > 0 ? 100 * census_time / update_time : 0.0);
+    }
+
+    if (cfg.counters) {
+        // cells updated, ghost cells received, and cells received and sent to the main process, a region is not counted
+        long long owned_cells = (long long)cfg.update_row_count * cfg.grid_width;
+        long long cells[COUNTER_PHASE_COUNT] = {dataflow ? 0 : owned_cells * cfg.total_iterations,
+            (long long)(cfg.num_rows - cfg.update_row_count) * cfg.grid_width * cfg.total_iterations, region ? owned_cells : 2 * owned_cells};
+        reportPerfCounters(&counters, worker_comm, cells, "Workers");
+    }
+    closePerfCounters(&counters);
 }
\ No newline at end of file
@@ -0,0 +1,136 @@
+#define _GNU_SOURCE // sched_setaffinity, MAP_HUGETLB
+#include "memory_placement.h"
+
+#include <sched.h> // sched_getaffinity, sched_setaffinity, sched_getcpu
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // strcmp, memset
+#include <sys/mman.h> // mmap, madvise
+#include <sys/syscall.h> // SYS_getcpu
+#include <unistd.h> // syscall
+
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+
+int parsePageMode(const char* name) {
+    if (strcmp(name, "default") == 0) {
+        return PAGES_DEFAULT;
+    } else if (strcmp(name, "thp") == 0) {
+        return PAGES_THP;
+    } else if (strcmp(name, "hugetlb") == 0) {
+        return PAGES_HUGETLB;
+    }
+    return -1;
+}
+
+const char* pageModeName(int mode) {
+    switch (mode) {
+        case PAGES_DEFAULT: return "default";
+        case PAGES_THP: return "thp";
+        case PAGES_HUGETLB: return "hugetlb";
+        default: return "unknown";
+    }
+}
+
+
+void placeWorker(WorkerPlacement* placement, MPI_Comm worker_comm, bool pin) {
+    placement->pinned = false;
+    if (pin) {
+        // the workers of one node share its CPUs, the rank on the node picks one of them
+        MPI_Comm node_comm;
+        int node_rank;
+        MPI_Comm_split_type(worker_comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+        MPI_Comm_rank(node_comm, &node_rank);
+        MPI_Comm_free(&node_comm);
+
+        cpu_set_t allowed;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0 && CPU_COUNT(&allowed) > 0) {
+            int target = node_rank % CPU_COUNT(&allowed);
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &allowed) && target-- == 0) {
+                    cpu_set_t single;
+                    CPU_ZERO(&single);
+                    CPU_SET(cpu, &single);
+                    placement->pinned = sched_setaffinity(0, sizeof(single), &single) == 0;
+                    break;
+                }
+            }
+        }
+        if (!placement->pinned) {
+            fprintf(stderr, "Warning: failed to pin the worker, it runs unpinned\n");
+        }
+    }
+
+    unsigned int cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) {
+        cpu = sched_getcpu();
+        node = 0;
+    }
+    placement->cpu = cpu;
+    placement->numa_node = node;
+}
+
+
+/**
+ * Writes every page once, the kernel places a page on the NUMA node of the CPU that touches it first
+ */
+static void touchPages(unsigned char* memory, size_t size) {
+    memset(memory, 0, size);
+}
+
+
+unsigned char* allocateGridMemory(size_t size, int mode, int* used_mode) {
+    unsigned char* memory = NULL;
+    size_t mapped_size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    if (mode == PAGES_HUGETLB) {
+        memory = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED) {
+            *used_mode = PAGES_HUGETLB;
+            touchPages(memory, size);
+            return memory;
+        }
+        mode = PAGES_THP; // no reserved huge pages left
+    }
+    if (mode == PAGES_THP) {
+        memory = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory != MAP_FAILED && madvise(memory, mapped_size, MADV_HUGEPAGE) == 0) {
+            *used_mode = PAGES_THP;
+            touchPages(memory, size);
+            return memory;
+        }
+        if (memory != MAP_FAILED) {
+            munmap(memory, mapped_size); // no transparent huge pages in this kernel
+        }
+    }
+
+    memory = malloc(size);
+    if (memory == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the grid\n");
+        exit(1);
+    }
+    *used_mode = PAGES_DEFAULT;
+    touchPages(memory, size);
+    return memory;
+}
+
+
+void freeGridMemory(unsigned char* memory, size_t size, int used_mode) {
+    if (used_mode == PAGES_DEFAULT) {
+        free(memory);
+    } else {
+        munmap(memory, (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+    }
+}
+
+
+int adviseGridMemory(unsigned char* memory, size_t size) {
+    uintptr_t start = ((uintptr_t)memory + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    uintptr_t end = ((uintptr_t)memory + size) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    int mode = PAGES_DEFAULT;
+    if (end > start && madvise((void*)start, end - start, MADV_HUGEPAGE) == 0) {
+        mode = PAGES_THP;
+    }
+    touchPages(memory, size);
+    return mode;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <mpi.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Page size of the local grids
+ */
+enum PageMode {
+    PAGES_DEFAULT = 0, // malloc, whatever the system gives
+    PAGES_THP = 1,     // anonymous mapping with madvise(MADV_HUGEPAGE), the kernel backs it with transparent huge pages
+    PAGES_HUGETLB = 2  // MAP_HUGETLB from the reserved 2 MB pages, falls back to PAGES_THP if none are left
+};
+
+int parsePageMode(const char* name);
+const char* pageModeName(int mode);
+
+/**
+ * Where a worker runs, read after pinning
+ *
+ * @param cpu The CPU the worker runs on
+ * @param numa_node The NUMA node of the CPU
+ * @param pinned Whether the worker is bound to the CPU
+ */
+struct WorkerPlacement {
+    int cpu;
+    int numa_node;
+    bool pinned;
+};
+typedef struct WorkerPlacement WorkerPlacement;
+
+/**
+ * Binds every worker to one CPU of its allowed CPUs, chosen by its rank among the workers of its node.
+ * Has to be called before the grid is allocated, so the first touch happens on the NUMA node of that CPU
+ *
+ * @param placement The placement to fill, also without pinning
+ * @param worker_comm The communicator of all workers
+ * @param pin Whether to bind the worker
+ */
+void placeWorker(WorkerPlacement* placement, MPI_Comm worker_comm, bool pin);
+
+/**
+ * Allocates memory for a grid with the requested page size and touches every page,
+ * so it is placed on the NUMA node of the calling worker
+ *
+ * @param size The number of bytes
+ * @param mode The requested PageMode
+ * @param used_mode The PageMode that was used, the one to pass to freeGridMemory
+ * @return The zeroed memory
+ */
+unsigned char* allocateGridMemory(size_t size, int mode, int* used_mode);
+
+void freeGridMemory(unsigned char* memory, size_t size, int used_mode);
+
+/**
+ * Asks for transparent huge pages for memory allocated by someone else (the MPI windows) and touches it.
+ * Only the 2 MB aligned part inside the memory can get huge pages
+ *
+ * @param memory The memory
+ * @param size The number of bytes
+ * @return PAGES_THP if the advice was accepted, otherwise PAGES_DEFAULT
+ */
+int adviseGridMemory(unsigned char* memory, size_t size);
@@ -0,0 +1,209 @@
+#include "out_of_core.h"
+
+#include <errno.h>
+#include <fcntl.h> // open, posix_fadvise
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // strerror
+#include <sys/mman.h>
+#include <unistd.h> // ftruncate, unlink, sysconf
+
+#include "utils.h"
+#include "utils_grid.h"
+
+
+static unsigned char* mapPartitionFile(OutOfCoreGrid* grid, WorkerConfig* cfg, int buffer) {
+    char path[PATTERN_PATH_LENGTH + 64];
+    snprintf(path, sizeof(path), OUT_OF_CORE_FILE_NAME, cfg->out_of_core_dir, cfg->world_rank, buffer);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || ftruncate(fd, grid->size) != 0) { // a sparse file, all cells are dead
+        fprintf(stderr, "Error: cannot create the partition file %s: %s\n", path, strerror(errno));
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    unsigned char* map = mmap(NULL, grid->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: cannot map the partition file %s: %s\n", path, strerror(errno));
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    unlink(path); // the mapping keeps the file, nothing is left behind if the run is killed
+    madvise(map, grid->size, MADV_SEQUENTIAL);
+    grid->fds[buffer] = fd;
+    return map;
+}
+
+void openOutOfCoreGrid(OutOfCoreGrid* grid, WorkerConfig* cfg) {
+    grid->size = (size_t)cfg->num_rows * cfg->grid_width;
+    grid->page_size = sysconf(_SC_PAGESIZE);
+    for (int buffer = 0; buffer < 2; buffer++) {
+        grid->maps[buffer] = mapPartitionFile(grid, cfg, buffer);
+        grid->views[buffer] = createGridView(grid->maps[buffer], cfg->num_rows, cfg->grid_width);
+    }
+    grid->current = 0;
+    cfg->local_grid = grid->views[0];
+    cfg->next_grid = grid->views[1];
+
+    // a band of the first generation has at least radius rows, so every band of a Larger than Life update has its ghost rows
+    grid->fuse = cfg->fuse;
+    grid->band_rows = max(OUT_OF_CORE_BAND_ROWS, cfg->rule.radius);
+    grid->ring_rows = 3 * cfg->rule.radius + 2 * grid->band_rows;
+    grid->ring_block = NULL;
+    grid->level_views = NULL;
+    if (grid->fuse > 1) {
+        grid->ring_block = malloc((size_t)(grid->fuse - 1) * grid->ring_rows * cfg->grid_width);
+        grid->level_views = calloc((size_t)(grid->fuse - 1) * cfg->num_rows, sizeof(unsigned char*));
+        if (grid->ring_block == NULL || grid->level_views == NULL) {
+            fprintf(stderr, "Failed to allocate memory for the rings of the sweep\n");
+            exit(1);
+        }
+    }
+    grid->bytes_sent = 0;
+}
+
+void closeOutOfCoreGrid(OutOfCoreGrid* grid, WorkerConfig* cfg) {
+    for (int buffer = 0; buffer < 2; buffer++) {
+        freeGridView(grid->views[buffer]);
+        munmap(grid->maps[buffer], grid->size);
+        close(grid->fds[buffer]);
+    }
+    free(grid->ring_block);
+    free(grid->level_views);
+    cfg->local_grid = NULL;
+    cfg->next_grid = NULL;
+}
+
+
+/**
+ * How far the sweep has advised the kernel about a mapping, in bytes from its start
+ */
+struct MappingStream {
+    size_t read_ahead;
+    size_t released;
+};
+typedef struct MappingStream MappingStream;
+
+/**
+ * Read-ahead of the rows in front of the sweep and release of the rows it no longer reads
+ *
+ * @param position The first byte the sweep has not read yet
+ * @param consumed The bytes before it are not read again in this sweep
+ */
+static void streamInput(OutOfCoreGrid* grid, int buffer, MappingStream* stream, size_t position, size_t consumed) {
+    unsigned char* map = grid->maps[buffer];
+    while (stream->read_ahead < grid->size && stream->read_ahead < position + OUT_OF_CORE_STREAM_BYTES) {
+        size_t length = grid->size - stream->read_ahead < OUT_OF_CORE_STREAM_BYTES ? grid->size - stream->read_ahead : OUT_OF_CORE_STREAM_BYTES;
+        madvise(map + stream->read_ahead, length, MADV_WILLNEED);
+        stream->read_ahead += length;
+    }
+    size_t end = consumed - consumed % grid->page_size;
+    if (end >= stream->released + OUT_OF_CORE_STREAM_BYTES) {
+        // the pages are clean, the next sweep writes them and reads them back from the file
+        madvise(map + stream->released, end - stream->released, MADV_DONTNEED);
+        posix_fadvise(grid->fds[buffer], stream->released, end - stream->released, POSIX_FADV_DONTNEED);
+        stream->released = end;
+    }
+}
+
+/**
+ * Write-behind of the rows the sweep finished
+ *
+ * @param written The bytes before it are not written again in this sweep
+ */
+static void streamOutput(OutOfCoreGrid* grid, int buffer, MappingStream* stream, size_t written) {
+    unsigned char* map = grid->maps[buffer];
+    size_t end = written - written % grid->page_size;
+    if (end >= stream->released + OUT_OF_CORE_STREAM_BYTES) {
+        msync(map + stream->released, end - stream->released, MS_ASYNC);
+        madvise(map + stream->released, end - stream->released, MADV_DONTNEED);
+        stream->released = end;
+    }
+}
+
+
+/**
+ * One sweep over the partition: generation k of the sweep (level k) is computed in bands as soon as level k - 1 has the
+ * radius rows below the band. Level 0 is the current file, the last level the other file, the levels in between are rings.
+ * A side with a neighbor loses radius valid rows per level, the ghost rows are deep enough for all of them
+ */
+static void sweepPartition(OutOfCoreGrid* grid, WorkerConfig* cfg, const KernelChoice* kernel, LargerThanLife* ltl, int generations) {
+    const int radius = cfg->rule.radius;
+    const int rows = cfg->num_rows;
+    const int width = cfg->grid_width;
+    const bool lower = cfg->world_rank > 1;
+    const bool upper = cfg->world_rank < cfg->world_size - 1;
+    unsigned char** levels[generations + 1];
+    int first[generations + 1], last[generations + 1], next[generations + 1];
+    for (int k = 0; k <= generations; k++) {
+        if (k == 0) {
+            levels[k] = grid->views[grid->current];
+        } else if (k == generations) {
+            levels[k] = grid->views[1 - grid->current];
+        } else {
+            levels[k] = grid->level_views + (size_t)(k - 1) * rows;
+        }
+        first[k] = lower ? radius * k : 0;
+        last[k] = upper ? rows - 1 - radius * k : rows - 1;
+        next[k] = first[k];
+    }
+
+    MappingStream input = {0, 0}, output = {0, 0};
+    WorkerConfig band = *cfg;
+    while (next[generations] <= last[generations]) {
+        for (int k = 1; k <= generations; k++) {
+            int limit;
+            if (k == 1) {
+                limit = next[1] + grid->band_rows - 1;
+                if (!upper && limit > rows - 1 - radius) {
+                    limit = rows - 1; // the last band of the grid takes the rest, a band needs radius rows below it or the end of the grid
+                }
+            } else if (next[k - 1] > last[k - 1]) {
+                limit = last[k];
+            } else {
+                limit = next[k - 1] - 1 - radius;
+            }
+            limit = min(limit, last[k]);
+            // the first band at the top of the grid has to end radius rows in, like the later bands start
+            if (limit < next[k] || (next[k] == 0 && limit < radius - 1 && limit < last[k])) {
+                break; // the later levels wait for this one
+            }
+            if (k < generations) {
+                unsigned char* ring = grid->ring_block + (size_t)(k - 1) * grid->ring_rows * width;
+                for (int r = next[k]; r <= limit; r++) {
+                    levels[k][r] = ring + (size_t)(r % grid->ring_rows) * width;
+                }
+            }
+            band.local_grid = levels[k - 1];
+            band.next_grid = levels[k];
+            band.update_start_row = next[k];
+            band.update_end_row = limit;
+            band.update_row_count = limit - next[k] + 1;
+            if (kernel != NULL) {
+                updateGridWithKernel(kernel, band);
+            } else {
+                updateGridLargerThanLife(ltl, band);
+            }
+            next[k] = limit + 1;
+        }
+        streamInput(grid, grid->current, &input, (size_t)next[1] * width, (size_t)max(next[1] - radius, 0) * width);
+        streamOutput(grid, 1 - grid->current, &output, (size_t)next[generations] * width);
+    }
+}
+
+
+void runOutOfCore(OutOfCoreGrid* grid, WorkerConfig* cfg, const KernelChoice* kernel, LargerThanLife* ltl, double* update_time, double* halo_time) {
+    int neighbors = (cfg->world_rank > 1) + (cfg->world_rank < cfg->world_size - 1);
+    for (int done = 0; done < cfg->total_iterations;) {
+        int generations = min(grid->fuse, cfg->total_iterations - done);
+        double start = MPI_Wtime();
+        sweepPartition(grid, cfg, kernel, ltl, generations);
+        grid->current = 1 - grid->current;
+        cfg->local_grid = grid->views[grid->current];
+        cfg->next_grid = grid->views[1 - grid->current];
+        double mid = MPI_Wtime();
+        // fuse x radius ghost rows at once, from and into the mapped rows
+        sendandReceiveUpdatedGridRows(*cfg);
+        grid->bytes_sent += (long long)neighbors * cfg->halo_depth * cfg->grid_width;
+        *update_time += mid - start;
+        *halo_time += MPI_Wtime() - mid;
+        done += generations;
+    }
+}
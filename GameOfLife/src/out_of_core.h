@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "game_of_life_mpi.h"
+#include "kernel_registry.h"
+#include "larger_than_life.h"
+
+// the partition files of a worker in the --out-of-core directory, %d is the world rank and the buffer
+#define OUT_OF_CORE_FILE_NAME "%s/mpi_partition-%d-%d.bin"
+// rows the first generation of a sweep computes at once, at least the radius
+#define OUT_OF_CORE_BAND_ROWS 32
+// the sweep advises the kernel about the mapped rows in steps of this many bytes
+#define OUT_OF_CORE_STREAM_BYTES (4 << 20)
+
+/**
+ * The grid of a worker in two memory mapped files on local disk instead of memory. A sweep reads one file from the
+ * top to the bottom and writes the other one, the generations in between live in rings of a few rows per generation
+ *
+ * @param fds The partition files, one per generation buffer
+ * @param maps The mappings of the files
+ * @param size The size of a file, num_rows x grid_width cells of one byte
+ * @param views The row views of the mappings, cfg->local_grid is views[current]
+ * @param current The buffer holding the current generation
+ * @param fuse The most generations one sweep computes, the ghost rows are fuse x radius deep
+ * @param band_rows The rows the first generation of the sweep computes at once
+ * @param ring_rows The rows of a ring
+ * @param ring_block The rings of the generations between the two files, fuse - 1 of them
+ * @param level_views The row views of the generations between the two files, num_rows pointers each
+ * @param page_size The granularity of madvise
+ * @param bytes_sent Halo payload sent to the neighbors
+ */
+struct OutOfCoreGrid {
+    int fds[2];
+    unsigned char* maps[2];
+    size_t size;
+    unsigned char** views[2];
+    int current;
+
+    int fuse;
+    int band_rows;
+    int ring_rows;
+    unsigned char* ring_block;
+    unsigned char** level_views;
+    size_t page_size;
+
+    long long bytes_sent;
+};
+typedef struct OutOfCoreGrid OutOfCoreGrid;
+
+/**
+ * Creates and maps the two partition files of the worker in the directory cfg->out_of_core_dir,
+ * cfg->local_grid and cfg->next_grid point into them. The files are removed when they are closed
+ *
+ * @param grid The grid to initialize
+ * @param cfg The worker process Config, cfg->halo_depth is fuse x radius
+ */
+void openOutOfCoreGrid(OutOfCoreGrid* grid, WorkerConfig* cfg);
+
+/**
+ * Advances the grid by cfg->total_iterations generations in sweeps of up to cfg->fuse generations (a wavefront):
+ * generation g + k of a row is computed as soon as generation g + k - 1 has the rows radius below it, so every sweep reads
+ * and writes the files once. The kernel reads ahead of the sweep (MADV_WILLNEED), the rows behind it are written back
+ * (msync with MS_ASYNC) and dropped from memory (MADV_DONTNEED). The ghost rows are exchanged once per sweep
+ *
+ * @param grid The grid
+ * @param cfg The worker process Config, local_grid holds the last generation afterwards
+ * @param kernel The update kernel for Conway's rule, NULL to update with the Larger than Life rule of cfg
+ * @param ltl The workspace of the Larger than Life update, unused with a kernel
+ * @param update_time The time of the sweeps is added to it
+ * @param halo_time The time of the exchanges is added to it
+ */
+void runOutOfCore(OutOfCoreGrid* grid, WorkerConfig* cfg, const KernelChoice* kernel, LargerThanLife* ltl, double* update_time, double* halo_time);
+
+/**
+ * Unmaps and removes the partition files
+ */
+void closeOutOfCoreGrid(OutOfCoreGrid* grid, WorkerConfig* cfg);
@@ -0,0 +1,255 @@
+#include "pattern_loader.h"
+
+#include <ctype.h> // isdigit, isspace
+#include <fcntl.h> // open
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // strcmp, strrchr, memchr
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include <unistd.h> // close
+
+
+const char* patternFormatName(int format) {
+    switch (format) {
+        case PATTERN_GRID: return "grid";
+        case PATTERN_PLAINTEXT: return "plaintext";
+        case PATTERN_RLE: return "rle";
+        default: return "unknown";
+    }
+}
+
+const char* patternErrorName(int error) {
+    switch (error) {
+        case PATTERN_OK: return "ok";
+        case PATTERN_ERROR_OPEN: return "cannot open the file";
+        case PATTERN_ERROR_NOT_FILE: return "not a regular file";
+        case PATTERN_ERROR_MAP: return "cannot map the file";
+        case PATTERN_ERROR_HEADER: return "missing or invalid RLE header";
+        default: return "unknown error";
+    }
+}
+
+static int detectPatternFormat(const char* path) {
+    const char* extension = strrchr(path, '.');
+    if (extension != NULL && strcmp(extension, ".rle") == 0) {
+        return PATTERN_RLE;
+    } else if (extension != NULL && strcmp(extension, ".cells") == 0) {
+        return PATTERN_PLAINTEXT;
+    }
+    return PATTERN_GRID;
+}
+
+
+/**
+ * Returns the offset after the line starting at offset, the line length without the line break is stored in length
+ */
+static size_t nextLine(const Pattern* pattern, size_t offset, size_t* length) {
+    const char* end = memchr(pattern->data + offset, '\n', pattern->size - offset);
+    size_t line_end = end == NULL ? pattern->size : (size_t)(end - pattern->data);
+    *length = line_end - offset;
+    if (*length > 0 && pattern->data[line_end - 1] == '\r') {
+        (*length)--;
+    }
+    return end == NULL ? pattern->size : line_end + 1;
+}
+
+
+static void indexGrid(Pattern* pattern) {
+    // all rows have the same length, so the offset of a row is computed from its index
+    size_t length;
+    pattern->data_start = 0;
+    pattern->row_stride = nextLine(pattern, 0, &length);
+    pattern->width = length;
+    pattern->height = pattern->row_stride == 0 ? 0 : (pattern->size + pattern->row_stride - 1) / pattern->row_stride;
+}
+
+
+static void indexPlaintext(Pattern* pattern) {
+    size_t capacity = 1024;
+    pattern->row_offsets = malloc(capacity * sizeof(size_t));
+    pattern->width = 0;
+    pattern->height = 0;
+
+    size_t offset = 0;
+    while (offset < pattern->size) {
+        size_t length;
+        size_t next = nextLine(pattern, offset, &length);
+        if (pattern->data[offset] != '!') {
+            if (pattern->height == (int)capacity) {
+                capacity *= 2;
+                pattern->row_offsets = realloc(pattern->row_offsets, capacity * sizeof(size_t));
+            }
+            if (pattern->row_offsets == NULL) {
+                fprintf(stderr, "Failed to allocate memory for the pattern row index\n");
+                exit(1);
+            }
+            pattern->row_offsets[pattern->height++] = offset;
+            if ((int)length > pattern->width) {
+                pattern->width = length;
+            }
+        }
+        offset = next;
+    }
+}
+
+
+static int readRleHeader(Pattern* pattern) {
+    size_t offset = 0;
+    while (offset < pattern->size) {
+        size_t length;
+        size_t next = nextLine(pattern, offset, &length);
+        if (pattern->data[offset] == 'x') {
+            // "x = m, y = n, rule = ..." the rule is ignored
+            char header[128];
+            size_t header_length = length < sizeof(header) - 1 ? length : sizeof(header) - 1;
+            memcpy(header, pattern->data + offset, header_length);
+            header[header_length] = '\0';
+            if (sscanf(header, "x = %d, y = %d", &pattern->width, &pattern->height) != 2 || pattern->width < 0 || pattern->height < 0) {
+                return PATTERN_ERROR_HEADER;
+            }
+            pattern->data_start = next;
+            return PATTERN_OK;
+        }
+        offset = next; // '#' comment lines
+    }
+    return PATTERN_ERROR_HEADER;
+}
+
+
+int openPattern(const char* path, Pattern* pattern) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return PATTERN_ERROR_OPEN;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        return PATTERN_ERROR_OPEN;
+    }
+    if (!S_ISREG(file_stat.st_mode)) {
+        close(fd);
+        return PATTERN_ERROR_NOT_FILE;
+    }
+
+    pattern->format = detectPatternFormat(path);
+    pattern->size = file_stat.st_size;
+    pattern->row_offsets = NULL;
+    pattern->data = NULL;
+    if (pattern->size > 0) {
+        pattern->data = mmap(NULL, pattern->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (pattern->data == MAP_FAILED) {
+            pattern->data = NULL;
+            close(fd);
+            return PATTERN_ERROR_MAP;
+        }
+    }
+    close(fd); // the mapping stays valid
+
+    switch (pattern->format) {
+        case PATTERN_RLE:
+            if (readRleHeader(pattern) != PATTERN_OK) {
+                closePattern(pattern);
+                return PATTERN_ERROR_HEADER;
+            }
+            break;
+        case PATTERN_PLAINTEXT:
+            indexPlaintext(pattern);
+            break;
+        default:
+            indexGrid(pattern);
+            break;
+    }
+    return PATTERN_OK;
+}
+
+
+void closePattern(Pattern* pattern) {
+    if (pattern->data != NULL) {
+        munmap((void*)pattern->data, pattern->size);
+    }
+    free(pattern->row_offsets);
+    pattern->data = NULL;
+    pattern->row_offsets = NULL;
+}
+
+
+/**
+ * Sets the cell of the pattern at (y, x) if it falls into the given rows of the grid
+ */
+static inline void setPatternCell(int y, int x, int offset_y, int offset_x, int first_row, int row_count, unsigned char** rows, int grid_width) {
+    int row = y + offset_y - first_row;
+    int column = x + offset_x;
+    if (row >= 0 && row < row_count && column >= 0 && column < grid_width) {
+        rows[row][column] = 1;
+    }
+}
+
+
+static void placeDenseRows(const Pattern* pattern, int offset_y, int offset_x, int first_row, int row_count, unsigned char** rows, int grid_width) {
+    // only the pattern rows that overlap with the given rows are parsed
+    int first_pattern_row = first_row - offset_y;
+    int last_pattern_row = first_row + row_count - 1 - offset_y;
+    if (first_pattern_row < 0) first_pattern_row = 0;
+    if (last_pattern_row > pattern->height - 1) last_pattern_row = pattern->height - 1;
+
+    for (int y = first_pattern_row; y <= last_pattern_row; y++) {
+        size_t offset = pattern->format == PATTERN_GRID ? pattern->data_start + y * pattern->row_stride : pattern->row_offsets[y];
+        size_t length;
+        nextLine(pattern, offset, &length);
+        const char* line = pattern->data + offset;
+        for (size_t x = 0; x < length; x++) {
+            char c = line[x];
+            int alive = pattern->format == PATTERN_GRID ? c == '1' : (c == 'O' || c == '*');
+            if (alive) {
+                setPatternCell(y, x, offset_y, offset_x, first_row, row_count, rows, grid_width);
+            }
+        }
+    }
+}
+
+
+static void placeRleRows(const Pattern* pattern, int offset_y, int offset_x, int first_row, int row_count, unsigned char** rows, int grid_width) {
+    // runs can span rows, so the stream is scanned from the start, but only the given rows are written
+    int last_pattern_row = first_row + row_count - 1 - offset_y;
+    int x = 0, y = 0;
+    size_t offset = pattern->data_start;
+    while (offset < pattern->size && y <= last_pattern_row) {
+        char c = pattern->data[offset++];
+        if (isspace((unsigned char)c)) {
+            continue;
+        }
+        int count = 1;
+        if (isdigit((unsigned char)c)) {
+            count = c - '0';
+            while (offset < pattern->size && isdigit((unsigned char)pattern->data[offset])) {
+                count = count * 10 + pattern->data[offset++] - '0';
+            }
+            if (offset >= pattern->size) break;
+            c = pattern->data[offset++];
+        }
+
+        if (c == '!') {
+            break;
+        } else if (c == '$') {
+            y += count;
+            x = 0;
+        } else if (c == 'b' || c == '.') {
+            x += count;
+        } else { // 'o' and the states of multi state rules are alive
+            for (int i = 0; i < count; i++) {
+                setPatternCell(y, x + i, offset_y, offset_x, first_row, row_count, rows, grid_width);
+            }
+            x += count;
+        }
+    }
+}
+
+
+void placePatternRows(const Pattern* pattern, int offset_y, int offset_x, int first_row, int row_count, unsigned char** rows, int grid_width) {
+    if (pattern->format == PATTERN_RLE) {
+        placeRleRows(pattern, offset_y, offset_x, first_row, row_count, rows, grid_width);
+    } else {
+        placeDenseRows(pattern, offset_y, offset_x, first_row, row_count, rows, grid_width);
+    }
+}
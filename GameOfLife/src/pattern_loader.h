@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+
+#define PATTERN_PATH_LENGTH 256
+
+/**
+ * Supported pattern files, detected by the file extension
+ */
+enum PatternFormat {
+    PATTERN_GRID = 0,      // one line of '0' and '1' per row, as written by writeGridToFile
+    PATTERN_PLAINTEXT = 1, // .cells: '.' dead, 'O' alive, lines starting with '!' are comments
+    PATTERN_RLE = 2        // .rle: header "x = <width>, y = <height>" and run length encoded rows
+};
+
+/**
+ * Why openPattern could not open a pattern file
+ */
+enum PatternError {
+    PATTERN_OK = 0,
+    PATTERN_ERROR_OPEN = 1,     // the file does not exist or cannot be read
+    PATTERN_ERROR_NOT_FILE = 2, // a directory or anything else that is not a regular file
+    PATTERN_ERROR_MAP = 3,      // the file cannot be mapped
+    PATTERN_ERROR_HEADER = 4    // .rle: the header "x = <width>, y = <height>" is missing or invalid
+};
+
+/**
+ * A memory mapped pattern file
+ *
+ * @param format The PatternFormat
+ * @param data The mapped file
+ * @param size The size of the file in bytes
+ * @param width The width of the pattern
+ * @param height The height of the pattern
+ * @param row_stride PATTERN_GRID: bytes per row including the line break
+ * @param row_offsets PATTERN_PLAINTEXT: offset of every row in data
+ * @param data_start PATTERN_GRID and PATTERN_RLE: offset of the first row in data
+ */
+struct Pattern {
+    int format;
+    const char* data;
+    size_t size;
+    int width;
+    int height;
+
+    size_t row_stride;
+    size_t* row_offsets;
+    size_t data_start;
+};
+typedef struct Pattern Pattern;
+
+/**
+ * Maps the pattern file and reads its size. The dense formats get their row offset index,
+ * the rows themselves are only parsed by placePatternRows
+ *
+ * @param path The path of the pattern file
+ * @param pattern The pattern to open, only closed if it was opened
+ * @return PATTERN_OK or the PatternError, nothing is left open on an error
+ */
+int openPattern(const char* path, Pattern* pattern);
+
+void closePattern(Pattern* pattern);
+
+const char* patternFormatName(int format);
+
+const char* patternErrorName(int error);
+
+/**
+ * Sets the alive cells of the pattern placed at (offset_y, offset_x) in the rows first_row to first_row + row_count - 1
+ * of a larger grid. Cells outside of the grid are clipped, dead cells are not written, so the rows need to be zeroed
+ *
+ * @param pattern The opened pattern
+ * @param offset_y The row of the grid the first pattern row is placed at, can be negative
+ * @param offset_x The column of the grid the first pattern column is placed at, can be negative
+ * @param first_row The row of the grid that rows[0] stores
+ * @param row_count The number of rows
+ * @param rows The rows of the grid
+ * @param grid_width The width of the grid
+ */
+void placePatternRows(const Pattern* pattern, int offset_y, int offset_x, int first_row, int row_count, unsigned char** rows, int grid_width);
@@ -0,0 +1,190 @@
+#include "perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h> // memset
+#include <sys/ioctl.h>
+#include <sys/syscall.h> // SYS_perf_event_open
+#include <unistd.h> // syscall, read, close
+
+
+static const char* counterPhaseNames[COUNTER_PHASE_COUNT] = {"update", "halo", "io"};
+
+
+static void describeEvent(int event, struct perf_event_attr* attr) {
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    switch (event) {
+        case COUNTER_CYCLES:
+            attr->type = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case COUNTER_INSTRUCTIONS:
+            attr->type = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case COUNTER_L1D_MISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case COUNTER_LLC_MISSES:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case COUNTER_BRANCH_MISSES:
+            attr->type = PERF_TYPE_HARDWARE;
+            attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+    }
+    // user space only, that is allowed with the default perf_event_paranoid
+    attr->exclude_kernel = 1;
+    attr->exclude_hv = 1;
+    attr->read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+}
+
+
+void openPerfCounters(PerfCounters* counters, bool enabled) {
+    memset(counters, 0, sizeof(*counters));
+    counters->group_fd = -1;
+    counters->phase = -1;
+    for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+        counters->fds[event] = -1;
+        counters->group_index[event] = -1;
+    }
+    if (!enabled) {
+        return;
+    }
+
+    for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+        struct perf_event_attr attr;
+        describeEvent(event, &attr);
+        attr.disabled = counters->group_fd == -1; // the leader starts the whole group
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, counters->group_fd, 0);
+        if (fd < 0) {
+            continue;
+        }
+        if (counters->group_fd == -1) {
+            counters->group_fd = fd;
+        }
+        counters->fds[event] = fd;
+        counters->group_index[event] = counters->event_count++;
+    }
+    if (counters->group_fd == -1) {
+        fprintf(stderr, "Warning: perf_event_open is not available (check /proc/sys/kernel/perf_event_paranoid), the counters are disabled\n");
+        return;
+    }
+    counters->enabled = true;
+    ioctl(counters->group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counters->group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+
+void closePerfCounters(PerfCounters* counters) {
+    for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+        if (counters->fds[event] >= 0) {
+            close(counters->fds[event]);
+            counters->fds[event] = -1;
+        }
+    }
+    counters->group_fd = -1;
+    counters->enabled = false;
+}
+
+
+/**
+ * Reads all events of the group with one system call
+ */
+static void readCounters(PerfCounters* counters, long long values[COUNTER_EVENT_COUNT]) {
+    uint64_t buffer[3 + COUNTER_EVENT_COUNT]; // nr, time_enabled, time_running, values
+    if (read(counters->group_fd, buffer, sizeof(buffer)) < (ssize_t)(3 * sizeof(uint64_t))) {
+        memset(values, 0, COUNTER_EVENT_COUNT * sizeof(long long));
+        return;
+    }
+    if (buffer[2] < buffer[1]) {
+        counters->multiplexed = true;
+    }
+    for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+        values[event] = counters->group_index[event] >= 0 ? (long long)buffer[3 + counters->group_index[event]] : 0;
+    }
+}
+
+
+void startCounterPhase(PerfCounters* counters, int phase) {
+    if (!counters->enabled) {
+        return;
+    }
+    counters->phase = phase;
+    readCounters(counters, counters->start);
+}
+
+
+void stopCounterPhase(PerfCounters* counters) {
+    if (!counters->enabled || counters->phase < 0) {
+        return;
+    }
+    long long now[COUNTER_EVENT_COUNT];
+    readCounters(counters, now);
+    for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+        counters->values[counters->phase][event] += now[event] - counters->start[event];
+    }
+    counters->phase = -1;
+}
+
+
+static void printPerCell(const char* name, long long value, int available, long long cells) {
+    if (available && cells > 0) {
+        printf(", %.4f %s", (double)value / cells, name);
+    } else {
+        printf(", %s n/a", name);
+    }
+}
+
+
+void reportPerfCounters(const PerfCounters* counters, MPI_Comm comm, const long long cells[COUNTER_PHASE_COUNT], const char* label) {
+    int available[COUNTER_EVENT_COUNT + 1], all_available[COUNTER_EVENT_COUNT + 1];
+    for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+        available[event] = counters->fds[event] >= 0;
+    }
+    available[COUNTER_EVENT_COUNT] = !counters->multiplexed;
+    long long sums[COUNTER_PHASE_COUNT][COUNTER_EVENT_COUNT];
+    long long cell_sums[COUNTER_PHASE_COUNT];
+    MPI_Reduce(available, all_available, COUNTER_EVENT_COUNT + 1, MPI_INT, MPI_MIN, 0, comm);
+    MPI_Reduce(counters->values, sums, COUNTER_PHASE_COUNT * COUNTER_EVENT_COUNT, MPI_LONG_LONG, MPI_SUM, 0, comm);
+    MPI_Reduce(cells, cell_sums, COUNTER_PHASE_COUNT, MPI_LONG_LONG, MPI_SUM, 0, comm);
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    if (rank != 0) {
+        return;
+    }
+    bool any_available = false;
+    for (int event = 0; event < COUNTER_EVENT_COUNT; event++) {
+        any_available |= all_available[event];
+    }
+    if (!any_available) {
+        printf("%s counters: not available on every process\n", label);
+        return;
+    }
+    for (int phase = 0; phase < COUNTER_PHASE_COUNT; phase++) {
+        const long long* sum = sums[phase];
+        if (cell_sums[phase] == 0) {
+            continue; // the phase did not run, the main process only has io
+        }
+        printf("%s counters %-6s:", label, counterPhaseNames[phase]);
+        if (all_available[COUNTER_CYCLES] && all_available[COUNTER_INSTRUCTIONS] && sum[COUNTER_CYCLES] > 0) {
+            printf(" IPC %.2f (%lld cycles)", (double)sum[COUNTER_INSTRUCTIONS] / sum[COUNTER_CYCLES], sum[COUNTER_CYCLES]);
+        } else {
+            printf(" IPC n/a");
+        }
+        printf(" per cell of %lld cells", cell_sums[phase]);
+        printPerCell("cycles", sum[COUNTER_CYCLES], all_available[COUNTER_CYCLES], cell_sums[phase]);
+        printPerCell("L1D misses", sum[COUNTER_L1D_MISSES], all_available[COUNTER_L1D_MISSES], cell_sums[phase]);
+        printPerCell("LLC misses", sum[COUNTER_LLC_MISSES], all_available[COUNTER_LLC_MISSES], cell_sums[phase]);
+        printPerCell("branch misses", sum[COUNTER_BRANCH_MISSES], all_available[COUNTER_BRANCH_MISSES], cell_sums[phase]);
+        printf("\n");
+    }
+    if (!all_available[COUNTER_EVENT_COUNT]) {
+        printf("%s counters: the events were multiplexed with other perf users, the values are too low\n", label);
+    }
+}
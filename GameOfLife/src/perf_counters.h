@@ -0,0 +1,85 @@
+#pragma once
+
+#include <mpi.h>
+#include <stdbool.h>
+
+/**
+ * The hardware events counted with perf_event_open
+ */
+enum CounterEvent {
+    COUNTER_CYCLES = 0,
+    COUNTER_INSTRUCTIONS = 1,
+    COUNTER_L1D_MISSES = 2,  // L1 data cache read misses
+    COUNTER_LLC_MISSES = 3,  // last level cache read misses
+    COUNTER_BRANCH_MISSES = 4,
+    COUNTER_EVENT_COUNT = 5
+};
+
+/**
+ * The phases of a worker the counters are attributed to
+ */
+enum CounterPhase {
+    COUNTER_PHASE_UPDATE = 0, // the update kernel
+    COUNTER_PHASE_HALO = 1,   // the halo exchange
+    COUNTER_PHASE_IO = 2,     // receiving or loading the initial grid and sending the result
+    COUNTER_PHASE_COUNT = 3
+};
+
+/**
+ * The counters of one process. The events are one perf group, so they are read together with one read at every phase change
+ *
+ * @param enabled Whether the counters are collected, false if --counters is off or no event could be opened
+ * @param group_fd The file descriptor of the group leader
+ * @param fds The file descriptors of the events, -1 if the event is not available
+ * @param group_index The position of every opened event in the group read
+ * @param event_count The number of opened events
+ * @param phase The running CounterPhase, -1 between phases
+ * @param start The event values at the start of the running phase
+ * @param values The accumulated event values per phase
+ * @param multiplexed Whether the kernel did not count the group all the time
+ */
+struct PerfCounters {
+    bool enabled;
+    int group_fd;
+    int fds[COUNTER_EVENT_COUNT];
+    int group_index[COUNTER_EVENT_COUNT];
+    int event_count;
+
+    int phase;
+    long long start[COUNTER_EVENT_COUNT];
+    long long values[COUNTER_PHASE_COUNT][COUNTER_EVENT_COUNT];
+    bool multiplexed;
+};
+typedef struct PerfCounters PerfCounters;
+
+/**
+ * Opens the counters of the calling process, only user space is counted.
+ * Events the CPU or the kernel do not provide are left out, without any the counters are disabled
+ *
+ * @param counters The counters to open
+ * @param enabled Whether the counters should be collected at all
+ */
+void openPerfCounters(PerfCounters* counters, bool enabled);
+
+void closePerfCounters(PerfCounters* counters);
+
+/**
+ * Attributes the events from now on to the phase
+ */
+void startCounterPhase(PerfCounters* counters, int phase);
+
+/**
+ * Adds the events since startCounterPhase to the running phase
+ */
+void stopCounterPhase(PerfCounters* counters);
+
+/**
+ * Sums the counters of all processes of comm on its rank 0, which prints IPC and misses per cell of every phase.
+ * An event is only reported if every process could count it
+ *
+ * @param counters The counters of the process
+ * @param comm The processes to sum over
+ * @param cells The cells every phase of the process worked on
+ * @param label Printed in front of the report
+ */
+void reportPerfCounters(const PerfCounters* counters, MPI_Comm comm, const long long cells[COUNTER_PHASE_COUNT], const char* label);
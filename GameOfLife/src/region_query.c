@@ -0,0 +1,62 @@
+#include "region_query.h"
+
+#include <stdio.h>
+#include <string.h> // strcmp
+
+#include "image_creation.h"
+
+
+int parseRegionFormat(const char* name) {
+    if (strcmp(name, "jpeg") == 0) {
+        return REGION_FORMAT_JPEG;
+    } else if (strcmp(name, "pbm") == 0) {
+        return REGION_FORMAT_PBM;
+    }
+    return -1;
+}
+
+const char* regionFormatName(int format) {
+    switch (format) {
+        case REGION_FORMAT_JPEG: return "jpeg";
+        case REGION_FORMAT_PBM: return "pbm";
+        default: return "unknown";
+    }
+}
+
+
+bool parseGridRegion(const char* text, GridRegion* region) {
+    int consumed = 0;
+    region->step = 1;
+    region->every = 0;
+    int fields = sscanf(text, "%d,%d,%d,%d%n,%d%n", &region->row, &region->column, &region->height, &region->width, &consumed, &region->step, &consumed);
+    if (fields < 4 || text[consumed] != '\0') {
+        return false;
+    }
+    return region->row >= 0 && region->column >= 0 && region->height > 0 && region->width > 0 && region->step >= 1;
+}
+
+bool hasGridRegion(const GridRegion* region) {
+    return region->height > 0;
+}
+
+int regionRows(const GridRegion* region) {
+    return (region->height + region->step - 1) / region->step;
+}
+
+int regionColumns(const GridRegion* region) {
+    return (region->width + region->step - 1) / region->step;
+}
+
+int regionSnapshotGenerations(const GridRegion* region, int done, int total) {
+    int remaining = total - done;
+    return region->every > 0 && region->every < remaining ? region->every : remaining;
+}
+
+
+void writeRegionFile(const char* file_name, unsigned char** cells, const GridRegion* region, int format) {
+    if (format == REGION_FORMAT_PBM) {
+        write_pbm_file((char*)file_name, cells, regionColumns(region), regionRows(region));
+    } else {
+        write_jpeg_file((char*)file_name, cells, regionColumns(region), regionRows(region));
+    }
+}
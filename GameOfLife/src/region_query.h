@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+
+// number of int fields of GridRegion, it is sent as one block of MPI_INT
+#define GRID_REGION_FIELD_COUNT 6
+
+/**
+ * A rectangle of the main grid, read from the workers that own its rows without gathering the grid
+ *
+ * @param row The first row in the main grid
+ * @param column The first column
+ * @param height The number of rows, 0 if there is no region
+ * @param width The number of columns
+ * @param step Downsampling, a pixel of the region is alive if any cell of its step x step block is alive
+ * @param every Generations between two snapshots of the region, 0 for the last generation only
+ */
+struct GridRegion {
+    int row;
+    int column;
+    int height;
+    int width;
+    int step;
+    int every;
+};
+typedef struct GridRegion GridRegion;
+
+/**
+ * How the main process writes a region
+ */
+enum RegionFormat {
+    REGION_FORMAT_JPEG = 0, // a grayscale jpeg like the full grid images
+    REGION_FORMAT_PBM = 1   // a portable bitmap, one bit per pixel and lossless
+};
+
+int parseRegionFormat(const char* name);
+const char* regionFormatName(int format);
+
+/**
+ * Parses <row>,<column>,<height>,<width>[,<step>], the step is 1 if it is missing and every is 0
+ *
+ * @return false if the text is invalid, the bounds of the grid are not checked
+ */
+bool parseGridRegion(const char* text, GridRegion* region);
+
+bool hasGridRegion(const GridRegion* region);
+
+/**
+ * The number of rows of the downsampled region
+ */
+int regionRows(const GridRegion* region);
+
+/**
+ * The number of columns of the downsampled region
+ */
+int regionColumns(const GridRegion* region);
+
+/**
+ * The number of generations until the next snapshot of the region, the last one is always at total
+ *
+ * @param region The region
+ * @param done The generations computed so far
+ * @param total The generations of the run
+ */
+int regionSnapshotGenerations(const GridRegion* region, int done, int total);
+
+/**
+ * Writes the received region, the file name should end in .jpg or .pbm
+ *
+ * @param file_name The file to write
+ * @param cells The region, regionRows x regionColumns cells
+ * @param region The region
+ * @param format The RegionFormat
+ */
+void writeRegionFile(const char* file_name, unsigned char** cells, const GridRegion* region, int format);
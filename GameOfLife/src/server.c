@@ -0,0 +1,458 @@
+#include "server.h"
+
+#include <errno.h>
+#include <fcntl.h> // open
+#include <signal.h> // SIGPIPE
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h> // sockaddr_un
+#include <unistd.h> // close, unlink, dup, dup2
+
+#include "dataflow.h"
+#include "halo_exchange.h"
+#include "kernel_registry.h"
+#include "larger_than_life.h"
+#include "memory_placement.h"
+#include "pattern_loader.h"
+#include "utils.h"
+#include "utils_grid.h"
+
+
+// share of alive cells of a random job
+#define SERVER_DENSITY 0.3f
+
+// the stdout of a server on stdin, the stdout of the main process goes to stderr then
+static FILE* server_answers = NULL;
+
+
+void reserveStdoutForAnswers(void) {
+    fflush(stdout);
+    int answers = dup(STDOUT_FILENO);
+    server_answers = answers < 0 ? NULL : fdopen(answers, "w");
+    if (server_answers == NULL || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+        fprintf(stderr, "Error: cannot keep stdout for the answers of the server: %s\n", strerror(errno));
+        exit(1);
+    }
+}
+
+
+/**
+ * Where the jobs come from and the answers go to. With a socket, input and output belong to the current client
+ */
+struct JobSource {
+    const char* socket_path; // NULL for stdin
+    int listen_fd;
+    FILE* input;
+    FILE* output;
+};
+typedef struct JobSource JobSource;
+
+
+static void openJobSource(JobSource* source, const char* serve) {
+    source->listen_fd = -1;
+    if (strcmp(serve, "stdin") == 0) {
+        source->socket_path = NULL;
+        source->input = stdin;
+        source->output = server_answers != NULL ? server_answers : stdout;
+        return;
+    }
+    source->socket_path = serve;
+    source->input = NULL;
+    source->output = NULL;
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(serve) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: the socket path %s is longer than %zu characters\n", serve, sizeof(address.sun_path) - 1);
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    strcpy(address.sun_path, serve);
+    unlink(serve); // left over from a server that was killed
+    source->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (source->listen_fd < 0 || bind(source->listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(source->listen_fd, 8) != 0) {
+        fprintf(stderr, "Error: cannot listen on %s: %s\n", serve, strerror(errno));
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    signal(SIGPIPE, SIG_IGN); // a client that leaves early must not kill the server, the write fails instead
+    printf("Master process: waiting for jobs on %s\n", serve);
+}
+
+static void closeClient(JobSource* source) {
+    if (source->socket_path != NULL && source->input != NULL) {
+        fclose(source->input);
+        fclose(source->output);
+        source->input = NULL;
+        source->output = NULL;
+    }
+}
+
+static void closeJobSource(JobSource* source) {
+    closeClient(source);
+    if (source->listen_fd >= 0) {
+        close(source->listen_fd);
+        unlink(source->socket_path);
+    }
+}
+
+/**
+ * Reads the next line, with a socket from the current client or the next one that connects
+ *
+ * @return false at the end of stdin
+ */
+static bool readJobLine(JobSource* source, char* line, int size) {
+    while (true) {
+        if (source->input == NULL) {
+            int client = accept(source->listen_fd, NULL, NULL);
+            if (client < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                fprintf(stderr, "Error: accept on %s failed: %s\n", source->socket_path, strerror(errno));
+                return false;
+            }
+            source->input = fdopen(client, "r");
+            source->output = fdopen(dup(client), "w");
+        }
+        if (fgets(line, size, source->input) != NULL) {
+            return true;
+        }
+        if (source->socket_path == NULL) {
+            return false;
+        }
+        closeClient(source);
+    }
+}
+
+static void answer(JobSource* source, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    vfprintf(source->output, format, args);
+    va_end(args);
+    fflush(source->output);
+}
+
+
+static bool parseJobNumber(const char* value, long min, long max, int* result) {
+    char* end;
+    errno = 0;
+    long number = strtol(value, &end, 0);
+    if (errno != 0 || end == value || *end != '\0' || number < min || number > max) {
+        return false;
+    }
+    *result = (int)number;
+    return true;
+}
+
+/**
+ * Parses a job line into a copy of the server config
+ *
+ * @param line The job, it is modified and the pattern of the job points into it
+ * @param defaults The config of the server
+ * @param job_id The number of the job, part of the default seed
+ * @param job The config of the job
+ * @param image The file the result is written to, empty for none
+ * @param error The reason if the job is invalid
+ * @return false if the job is invalid
+ */
+static bool parseJob(char* line, const GameConfig* defaults, int job_id, GameConfig* job, char* image, char* error, size_t error_size) {
+    *job = *defaults;
+    job->seed = defaults->seed + job_id;
+    job->region = (GridRegion){0, 0, 0, 0, 1, 0};
+    image[0] = '\0';
+    char* save;
+    for (char* token = strtok_r(line, " \t\r\n", &save); token != NULL; token = strtok_r(NULL, " \t\r\n", &save)) {
+        char* value = strchr(token, '=');
+        if (value == NULL) {
+            snprintf(error, error_size, "expected name=value, got %s", token);
+            return false;
+        }
+        *value++ = '\0';
+        bool valid = true;
+        if (strcmp(token, "size") == 0) {
+            valid = parseJobNumber(value, 10, 40000, &job->width);
+            job->height = job->width;
+        } else if (strcmp(token, "generations") == 0) {
+            valid = parseJobNumber(value, 1, 1000000, &job->total_iterations);
+        } else if (strcmp(token, "seed") == 0) {
+            valid = parseJobNumber(value, -2147483647L - 1, 2147483647L, &job->seed);
+        } else if (strcmp(token, "rule") == 0) {
+            valid = parseLifeRule(value, &job->rule);
+        } else if (strcmp(token, "pattern") == 0) {
+            valid = strlen(value) < PATTERN_PATH_LENGTH;
+            job->pattern_file = value;
+        } else if (strcmp(token, "pattern-offset") == 0) {
+            valid = sscanf(value, "%d,%d", &job->pattern_offset_y, &job->pattern_offset_x) == 2;
+            job->pattern_offset_set = true;
+        } else if (strcmp(token, "region") == 0) {
+            valid = parseGridRegion(value, &job->region);
+        } else if (strcmp(token, "image") == 0) {
+            valid = strlen(value) < PATTERN_PATH_LENGTH;
+            snprintf(image, PATTERN_PATH_LENGTH, "%s", value);
+        } else {
+            snprintf(error, error_size, "unknown field %s", token);
+            return false;
+        }
+        if (!valid) {
+            snprintf(error, error_size, "invalid value for %s", token);
+            return false;
+        }
+    }
+
+    // the checks of parseArguments and distributeAndSendConfig, which would stop the server
+    int neighborhood = (2 * job->rule.radius + 1) * (2 * job->rule.radius + 1);
+    if (job->rule.survive_max > neighborhood || job->rule.birth_max > neighborhood) {
+        snprintf(error, error_size, "the rule counts more than the %d cells of its neighborhood", neighborhood);
+        return false;
+    }
+    if (hasGridRegion(&job->region) && (job->region.row + job->region.height > job->height || job->region.column + job->region.width > job->width)) {
+        snprintf(error, error_size, "the region does not fit into the grid of %d x %d cells", job->width, job->height);
+        return false;
+    }
+    if (hasGridRegion(&job->region) && image[0] == '\0') {
+        snprintf(error, error_size, "a region needs an image to write it to");
+        return false;
+    }
+    if (job->kernel != UPDATE_KERNEL_AUTO && !isConwayRule(&job->rule)) {
+        snprintf(error, error_size, "the server forces a kernel, it only computes Conway's Game of Life");
+        return false;
+    }
+    if (job->pattern_file != NULL) {
+        // the workers open it again and abort on the errors
+        Pattern pattern;
+        int pattern_error = openPattern(job->pattern_file, &pattern);
+        if (pattern_error != PATTERN_OK) {
+            snprintf(error, error_size, "cannot load the pattern %s: %s", job->pattern_file, patternErrorName(pattern_error));
+            return false;
+        }
+        bool empty = pattern.width <= 0 || pattern.height <= 0;
+        if (!empty && !job->pattern_offset_set) {
+            job->pattern_offset_y = (job->height - pattern.height) / 2;
+            job->pattern_offset_x = (job->width - pattern.width) / 2;
+        }
+        closePattern(&pattern);
+        if (empty) {
+            snprintf(error, error_size, "the pattern %s has no cells", job->pattern_file);
+            return false;
+        }
+    }
+    if (image[0] != '\0') {
+        // the image writers exit on an error, the file is created here first
+        int fd = open(image, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            snprintf(error, error_size, "cannot create the image %s: %s", image, strerror(errno));
+            return false;
+        }
+        close(fd);
+    }
+    return true;
+}
+
+
+/**
+ * Runs one job on the workers and collects its result
+ *
+ * @return The number of alive cells of the last generation
+ */
+static long long runJob(const GameConfig* job, const char* image, int world_size, bool* warm) {
+    int command[2] = {SERVER_JOB, image[0] != '\0'};
+    MPI_Bcast(command, 2, MPI_INT, 0, MPI_COMM_WORLD);
+    WorkerConfig workerConfigs[world_size - 1];
+    distributeAndSendConfig(world_size, job, workerConfigs);
+
+    long long population = 0, no_cells = 0;
+    MPI_Reduce(&no_cells, &population, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    int all_warm = 1, warm_workers;
+    MPI_Reduce(&all_warm, &warm_workers, 1, MPI_INT, MPI_MIN, 0, MPI_COMM_WORLD);
+    *warm = warm_workers != 0;
+    if (command[1]) {
+        // the whole grid is a region without downsampling, gathered with one collective
+        GridRegion region = hasGridRegion(&job->region) ? job->region : (GridRegion){0, 0, job->height, job->width, 1, 0};
+        int rows = regionRows(&region), columns = regionColumns(&region);
+        unsigned char* cells_block = createGridSingleBlock(rows, columns);
+        unsigned char** cells = createGridView(cells_block, rows, columns);
+        if (hasGridRegion(&job->region)) {
+            receiveRegion(workerConfigs, world_size, &region, job->pack_transfers, cells);
+        } else {
+            receiveGridParts(workerConfigs, cells, job->height, job->width, world_size, job->pack_transfers);
+        }
+        size_t length = strlen(image);
+        writeRegionFile(image, cells, &region, length > 4 && strcmp(image + length - 4, ".pbm") == 0 ? REGION_FORMAT_PBM : REGION_FORMAT_JPEG);
+        freeGridView(cells);
+        free(cells_block);
+    }
+    return population;
+}
+
+
+void runServerMaster(const GameConfig* cfg, int world_size) {
+    JobSource source;
+    openJobSource(&source, cfg->serve);
+    int worker_amount = world_size - 1;
+    char line[SERVER_LINE_LENGTH];
+    char image[PATTERN_PATH_LENGTH];
+    char error[160];
+    int job_id = 0, jobs_done = 0;
+    double busy_time = 0, first_job_time = 0, last_job_time = 0;
+
+    while (readJobLine(&source, line, sizeof(line))) {
+        char* text = line + strspn(line, " \t\r\n");
+        if (text[0] == '\0' || text[0] == '#') {
+            continue;
+        }
+        if (strncmp(text, "quit", 4) == 0 && strspn(text + 4, " \t\r\n") == strlen(text + 4)) {
+            answer(&source, "bye\n");
+            break;
+        }
+        job_id++;
+        GameConfig job;
+        if (!parseJob(text, cfg, job_id, &job, image, error, sizeof(error))) {
+            answer(&source, "job %d error %s\n", job_id, error);
+            continue;
+        }
+        if (worker_amount > 1 && job.height / worker_amount < job.rule.radius) {
+            answer(&source, "job %d error every worker needs at least %d rows for radius %d, the size is too small\n", job_id, job.rule.radius, job.rule.radius);
+            continue;
+        }
+
+        double start_time = MPI_Wtime();
+        if (jobs_done == 0) {
+            first_job_time = start_time;
+        }
+        bool warm;
+        long long population = runJob(&job, image, world_size, &warm);
+        last_job_time = MPI_Wtime();
+        double seconds = last_job_time - start_time;
+        busy_time += seconds;
+        jobs_done++;
+        answer(&source, "job %d ok size=%d generations=%d population=%lld seconds=%.6f warm=%s%s%s\n", job_id, job.width, job.total_iterations,
+            population, seconds, warm ? "yes" : "no", image[0] != '\0' ? " image=" : "", image);
+        if (source.socket_path != NULL) {
+            printf("Master process: job %d, %dx%d for %d generations in %f seconds%s\n", job_id, job.width, job.height, job.total_iterations, seconds, warm ? ", warm" : "");
+        }
+    }
+
+    int command[2] = {SERVER_STOP, 0};
+    MPI_Bcast(command, 2, MPI_INT, 0, MPI_COMM_WORLD);
+    closeJobSource(&source);
+    double wall_time = last_job_time - first_job_time;
+    printf("Master process: served %d jobs in %f seconds, %f seconds running them: %.1f jobs per minute\n", jobs_done, wall_time, busy_time,
+        busy_time > 0 ? jobs_done / busy_time * 60 : 0.0);
+}
+
+
+/**
+ * Whether the rows of the worker are the same as in the job before, then the buffers and the halo exchange can stay
+ */
+static bool sameGeometry(const WorkerConfig* a, const WorkerConfig* b) {
+    return a->num_rows == b->num_rows && a->grid_width == b->grid_width && a->halo_depth == b->halo_depth
+        && a->update_start_row == b->update_start_row && a->update_end_row == b->update_end_row;
+}
+
+void runServerWorker(WorkerConfig cfg, MPI_Comm worker_comm) {
+    WorkerPlacement placement;
+    placeWorker(&placement, worker_comm, cfg.pin); // once, the buffers of all jobs are first touched on this CPU
+    int thread_support;
+    MPI_Query_thread(&thread_support);
+    if (cfg.schedule == SCHEDULE_DATAFLOW && thread_support < MPI_THREAD_FUNNELED) {
+        fprintf(stderr, "Warning: the MPI library does not support threads, worker %d uses the lockstep schedule\n", cfg.world_rank);
+        cfg.schedule = SCHEDULE_LOCKSTEP;
+    }
+    int schedule = cfg.schedule;
+
+    // kept across jobs, valid once the first job created them
+    WorkerConfig previous;
+    bool allocated = false;
+    bool kernel_selected = false;
+    HaloExchange halo;
+    KernelChoice kernel;
+    LargerThanLife ltl;
+    PerfCounters counters;
+    openPerfCounters(&counters, false);
+    int jobs = 0, warm_jobs = 0;
+    double job_time = 0;
+
+    while (true) {
+        int command[2];
+        MPI_Bcast(command, 2, MPI_INT, 0, MPI_COMM_WORLD);
+        if (command[0] == SERVER_STOP) {
+            break;
+        }
+        cfg = receiveWorkerConfig();
+        cfg.schedule = schedule;
+        double start_time = MPI_Wtime();
+
+        // all workers recreate their exchange together, the backends with windows and graphs are collective
+        int warm = allocated && sameGeometry(&cfg, &previous), all_warm;
+        MPI_Allreduce(&warm, &all_warm, 1, MPI_INT, MPI_MIN, worker_comm);
+        if (all_warm) {
+            cfg.local_grid = previous.local_grid; // the generation parity of the last job decides which buffer is current
+            cfg.next_grid = previous.next_grid;
+        } else {
+            if (allocated) {
+                freeHaloExchange(&halo, &previous);
+                freeLargerThanLife(&ltl);
+                if (kernel_selected) {
+                    freeKernelChoice(&kernel);
+                    kernel_selected = false;
+                }
+            }
+            initHaloExchange(&halo, &cfg, worker_comm);
+            initLargerThanLife(&ltl, cfg);
+            allocated = true;
+        }
+
+        if (cfg.pattern_file[0] != '\0') {
+            loadInitialGrid(&cfg);
+        } else {
+            seedInitialGrid(&cfg, SERVER_DENSITY);
+        }
+        exchangeHaloRows(&halo, cfg);
+        bool conway = isConwayRule(&cfg.rule);
+        if (conway && !kernel_selected) {
+            selectUpdateKernel(&kernel, cfg); // benchmarks on the grid of the first job of this size only
+            kernel_selected = true;
+        }
+
+        double update_time = 0, halo_time = 0;
+        if (schedule == SCHEDULE_DATAFLOW) {
+            DataflowStats stats;
+            runDataflow(&cfg, &halo, conway ? &kernel : NULL, cfg.threads, &stats);
+        } else {
+            runLockstep(&cfg, &halo, conway ? &kernel : NULL, &ltl, &counters, &update_time, &halo_time);
+        }
+
+        long long population = 0, total_population;
+        for (int i = cfg.update_start_row; i <= cfg.update_end_row; i++) {
+            for (int j = 0; j < cfg.grid_width; j++) {
+                population += cfg.local_grid[i][j];
+            }
+        }
+        MPI_Reduce(&population, &total_population, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        int warm_workers;
+        MPI_Reduce(&all_warm, &warm_workers, 1, MPI_INT, MPI_MIN, 0, MPI_COMM_WORLD);
+        if (command[1] && hasGridRegion(&cfg.region)) {
+            sendRegionToMain(cfg);
+        } else if (command[1]) {
+            sendGridToMain(cfg);
+        }
+        previous = cfg;
+        jobs++;
+        warm_jobs += all_warm;
+        job_time += MPI_Wtime() - start_time;
+    }
+
+    if (allocated) {
+        freeHaloExchange(&halo, &previous);
+        freeLargerThanLife(&ltl);
+        if (kernel_selected) {
+            freeKernelChoice(&kernel);
+        }
+    }
+    closePerfCounters(&counters);
+    // on stderr, the stdout of a server on stdin carries the answers only
+    fprintf(stderr, "Worker process %2d: cpu %d, %d jobs, %d of them warm, %f seconds running them\n", cfg.world_rank, placement.cpu, jobs, warm_jobs, job_time);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <mpi.h>
+
+#include "arg_parser.h"
+#include "game_of_life_mpi.h"
+
+// longest job line, including the newline
+#define SERVER_LINE_LENGTH 1024
+
+/**
+ * What the main process broadcasts to the workers before every job
+ */
+enum ServerCommand {
+    SERVER_STOP = 0, // free everything and return
+    SERVER_JOB = 1   // receive the WorkerConfig of the next job and run it
+};
+
+/**
+ * For --serve=stdin: keeps the stdout of the main process for the answers of the server and points stdout to stderr,
+ * so a client reading the answers gets one line per job and nothing else. Called before the main process prints anything
+ */
+void reserveStdoutForAnswers(void);
+
+/**
+ * Runs the server on the main process. Reads one job per line from stdin or from the clients of the unix socket cfg->serve,
+ * one client after the other, and answers every line with one line:
+ *
+ *     size=1000 generations=500 rule=life seed=7 image=result.jpg
+ *     job 1 ok size=1000 generations=500 population=40211 seconds=0.412 warm=yes image=result.jpg
+ *
+ * A job is a list of name=value pairs: size, generations and rule default to the arguments of the server, seed to the
+ * seed of the server plus the job number, pattern and pattern-offset work like the options, image writes the result
+ * as jpeg or, if its name ends in .pbm, as portable bitmap, and region=<row>,<column>,<height>,<width>[,<step>] limits it to a rectangle.
+ * "quit" or the end of stdin stops the server and the workers.
+ * Needs the workers in runServerWorker, so distributeAndSendConfig has been called with cfg before
+ *
+ * @param cfg The parsed arguments, the defaults of the jobs and the options of the workers
+ * @param world_size The total number of processes
+ */
+void runServerMaster(const GameConfig* cfg, int world_size);
+
+/**
+ * Runs the jobs of the server on a worker until it is stopped. The worker keeps its placement, its halo exchange with the
+ * grid buffers and its update kernel across jobs, they are only recreated when the rows of the worker change,
+ * so a job of the same size and radius as the one before starts warm without allocating or benchmarking
+ *
+ * @param cfg The config from distributeAndSendConfig, only its options are used
+ * @param worker_comm The communicator of all workers
+ */
+void runServerWorker(WorkerConfig cfg, MPI_Comm worker_comm);
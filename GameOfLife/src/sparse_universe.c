@@ -0,0 +1,700 @@
+#include "sparse_universe.h"
+
+#include <limits.h> // INT_MAX, INT_MIN
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h> // strcmp, memset, memcpy
+
+#include "image_creation.h"
+#include "memory_placement.h"
+#include "pattern_loader.h"
+#include "perf_counters.h"
+#include "utils_grid.h"
+
+// share of alive cells in the random initial square
+#define SPARSE_DENSITY 0.3
+#define SPARSE_INITIAL_CAPACITY 64
+
+/**
+ * A border of a tile on its way to the owner of a neighboring tile
+ *
+ * @param ty The tile row of the receiving tile
+ * @param tx The tile column of the receiving tile
+ * @param gy The side of the ghost ring it is written to: -1 top, 1 bottom, 0 the rows of the tile
+ * @param gx The side of the ghost ring it is written to: -1 left, 1 right, 0 the columns of the tile
+ * @param cells SPARSE_TILE_SIZE cells for an edge, one for a corner
+ */
+struct SparseStrip {
+    int ty;
+    int tx;
+    signed char gy;
+    signed char gx;
+    unsigned char cells[SPARSE_TILE_SIZE];
+};
+typedef struct SparseStrip SparseStrip;
+
+
+int parseUniverse(const char* name) {
+    if (strcmp(name, "dense") == 0) {
+        return UNIVERSE_DENSE;
+    } else if (strcmp(name, "sparse") == 0) {
+        return UNIVERSE_SPARSE;
+    }
+    return -1;
+}
+
+const char* universeName(int universe) {
+    switch (universe) {
+        case UNIVERSE_DENSE: return "dense";
+        case UNIVERSE_SPARSE: return "sparse";
+        default: return "unknown";
+    }
+}
+
+
+static uint64_t mixBits(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * Moves the 32 bits of v to the even bits of the result
+ */
+static uint64_t spreadBits(uint32_t v) {
+    uint64_t x = v;
+    x = (x | x << 16) & 0x0000FFFF0000FFFFULL;
+    x = (x | x << 8) & 0x00FF00FF00FF00FFULL;
+    x = (x | x << 4) & 0x0F0F0F0F0F0F0F0FULL;
+    x = (x | x << 2) & 0x3333333333333333ULL;
+    x = (x | x << 1) & 0x5555555555555555ULL;
+    return x;
+}
+
+/**
+ * The worker of a tile. Tiles close on the Z-order curve share a block and with it a worker,
+ * the blocks are spread over the workers by a hash so a growing pattern does not stay on one of them
+ */
+static int tileOwner(const SparseUniverse* universe, int ty, int tx) {
+    // flipping the sign bit keeps negative coordinates next to positive ones on the curve
+    uint64_t morton = spreadBits((uint32_t)ty ^ 0x80000000u) << 1 | spreadBits((uint32_t)tx ^ 0x80000000u);
+    return (int)(mixBits(morton >> (2 * SPARSE_BLOCK_BITS)) % (uint64_t)universe->workers);
+}
+
+static int floorDiv(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+
+static size_t tileSlot(const SparseTileMap* map, int ty, int tx) {
+    return mixBits((uint64_t)(uint32_t)ty << 32 | (uint32_t)tx) & (map->capacity - 1);
+}
+
+static void initTileMap(SparseTileMap* map) {
+    map->capacity = SPARSE_INITIAL_CAPACITY;
+    map->count = 0;
+    map->slots = calloc(map->capacity, sizeof(SparseTile*));
+    if (map->slots == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the tile map\n");
+        exit(1);
+    }
+}
+
+static SparseTile* findTile(const SparseTileMap* map, int ty, int tx) {
+    for (size_t i = tileSlot(map, ty, tx);; i = (i + 1) & (map->capacity - 1)) {
+        SparseTile* tile = map->slots[i];
+        if (tile == NULL || (tile->ty == ty && tile->tx == tx)) {
+            return tile;
+        }
+    }
+}
+
+static void insertSlot(SparseTileMap* map, SparseTile* tile) {
+    size_t i = tileSlot(map, tile->ty, tile->tx);
+    while (map->slots[i] != NULL) {
+        i = (i + 1) & (map->capacity - 1);
+    }
+    map->slots[i] = tile;
+}
+
+/**
+ * Adds a dead tile, the map stays at most half full
+ */
+static SparseTile* createTile(SparseTileMap* map, int ty, int tx) {
+    if (2 * (map->count + 1) > map->capacity) {
+        SparseTile** old_slots = map->slots;
+        size_t old_capacity = map->capacity;
+        map->capacity *= 2;
+        map->slots = calloc(map->capacity, sizeof(SparseTile*));
+        if (map->slots == NULL) {
+            fprintf(stderr, "Failed to allocate memory for the tile map\n");
+            exit(1);
+        }
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (old_slots[i] != NULL) {
+                insertSlot(map, old_slots[i]);
+            }
+        }
+        free(old_slots);
+    }
+    SparseTile* tile = calloc(1, sizeof(SparseTile));
+    if (tile == NULL) {
+        fprintf(stderr, "Failed to allocate memory for a tile\n");
+        exit(1);
+    }
+    tile->ty = ty;
+    tile->tx = tx;
+    insertSlot(map, tile);
+    map->count++;
+    return tile;
+}
+
+/**
+ * Frees the tile and moves the following tiles of its probe chain into the hole, so no tombstones are needed
+ */
+static void removeTile(SparseTileMap* map, SparseTile* tile) {
+    size_t mask = map->capacity - 1;
+    size_t hole = tileSlot(map, tile->ty, tile->tx);
+    while (map->slots[hole] != tile) {
+        hole = (hole + 1) & mask;
+    }
+    free(tile);
+    map->slots[hole] = NULL;
+    map->count--;
+    for (size_t i = (hole + 1) & mask; map->slots[i] != NULL; i = (i + 1) & mask) {
+        size_t home = tileSlot(map, map->slots[i]->ty, map->slots[i]->tx);
+        // the tile may move to the hole if its home slot is not between the hole and its slot
+        bool reachable = hole < i ? (home <= hole || home > i) : (home <= hole && home > i);
+        if (reachable) {
+            map->slots[hole] = map->slots[i];
+            map->slots[i] = NULL;
+            hole = i;
+        }
+    }
+}
+
+static void freeTileMap(SparseTileMap* map) {
+    for (size_t i = 0; i < map->capacity; i++) {
+        free(map->slots[i]);
+    }
+    free(map->slots);
+    map->slots = NULL;
+    map->count = 0;
+}
+
+
+static unsigned char* tileCell(SparseTile* tile, int generation, int y, int x) {
+    return &tile->cells[generation][(y + 1) * SPARSE_TILE_STRIDE + x + 1];
+}
+
+static bool tileIsAlive(const SparseTile* tile, int generation) {
+    const unsigned char* cells = tile->cells[generation];
+    unsigned char alive = 0;
+    for (int y = 1; y <= SPARSE_TILE_SIZE; y++) {
+        for (int x = 1; x <= SPARSE_TILE_SIZE; x++) {
+            alive |= cells[y * SPARSE_TILE_STRIDE + x];
+        }
+    }
+    return alive != 0;
+}
+
+
+/**
+ * The rows or columns of a strip in the padded tile. The sender reads its border on the side of the receiver,
+ * the receiver writes it to the ghost ring on the side of the sender
+ */
+static void stripRange(int side, bool ghost, int* first, int* count) {
+    if (side == 0) {
+        *first = 1;
+        *count = SPARSE_TILE_SIZE;
+    } else {
+        *first = ghost ? (side < 0 ? 0 : SPARSE_TILE_SIZE + 1) : (side < 0 ? SPARSE_TILE_SIZE : 1);
+        *count = 1;
+    }
+}
+
+/**
+ * Copies the border of the tile that the neighbor in direction (dy, dx) needs
+ *
+ * @return Whether the border has alive cells
+ */
+static bool extractStrip(const SparseTile* tile, int generation, int dy, int dx, SparseStrip* strip) {
+    strip->ty = tile->ty + dy;
+    strip->tx = tile->tx + dx;
+    strip->gy = -dy;
+    strip->gx = -dx;
+    int first_row, rows, first_column, columns;
+    stripRange(strip->gy, false, &first_row, &rows);
+    stripRange(strip->gx, false, &first_column, &columns);
+    unsigned char alive = 0;
+    const unsigned char* cells = tile->cells[generation];
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < columns; c++) {
+            unsigned char cell = cells[(first_row + r) * SPARSE_TILE_STRIDE + first_column + c];
+            strip->cells[r * columns + c] = cell;
+            alive |= cell;
+        }
+    }
+    return alive != 0;
+}
+
+static void applyStrip(SparseTile* tile, int generation, const SparseStrip* strip) {
+    int first_row, rows, first_column, columns;
+    stripRange(strip->gy, true, &first_row, &rows);
+    stripRange(strip->gx, true, &first_column, &columns);
+    unsigned char* cells = tile->cells[generation];
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < columns; c++) {
+            cells[(first_row + r) * SPARSE_TILE_STRIDE + first_column + c] = strip->cells[r * columns + c];
+        }
+    }
+}
+
+static void clearGhostRing(SparseTile* tile, int generation) {
+    unsigned char* cells = tile->cells[generation];
+    memset(cells, 0, SPARSE_TILE_STRIDE);
+    memset(cells + (SPARSE_TILE_SIZE + 1) * SPARSE_TILE_STRIDE, 0, SPARSE_TILE_STRIDE);
+    for (int y = 1; y <= SPARSE_TILE_SIZE; y++) {
+        cells[y * SPARSE_TILE_STRIDE] = 0;
+        cells[y * SPARSE_TILE_STRIDE + SPARSE_TILE_SIZE + 1] = 0;
+    }
+}
+
+
+/**
+ * The forced kernel, otherwise the widest vector kernel of the CPU. The rows of a tile are too short to benchmark them
+ */
+static int chooseTileKernel(int requested, int rank) {
+    if (requested != UPDATE_KERNEL_AUTO) {
+        if (!isUpdateKernelSupported(requested)) {
+            fprintf(stderr, "Rank %d: the %s kernel is not supported by this CPU\n", rank, updateKernelName(requested));
+            exit(1);
+        }
+        return requested;
+    }
+    const int preferred[] = {UPDATE_KERNEL_AVX512, UPDATE_KERNEL_AVX2, UPDATE_KERNEL_SSE2};
+    for (size_t i = 0; i < sizeof(preferred) / sizeof(preferred[0]); i++) {
+        if (isUpdateKernelSupported(preferred[i])) {
+            return preferred[i];
+        }
+    }
+    return UPDATE_KERNEL_SCALAR;
+}
+
+
+static void fillFromPattern(SparseUniverse* universe, WorkerConfig cfg) {
+    Pattern pattern;
+    int error = openPattern(cfg.pattern_file, &pattern);
+    if (error != PATTERN_OK) {
+        fprintf(stderr, "Error: worker %d cannot load the pattern %s: %s\n", cfg.world_rank, cfg.pattern_file, patternErrorName(error));
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (pattern.width > 0 && pattern.height > 0) {
+        // one band of tile rows at a time, every worker parses the whole pattern and keeps its tiles
+        int ty0 = floorDiv(cfg.pattern_offset_y, SPARSE_TILE_SIZE);
+        int ty1 = floorDiv(cfg.pattern_offset_y + pattern.height - 1, SPARSE_TILE_SIZE);
+        int tx0 = floorDiv(cfg.pattern_offset_x, SPARSE_TILE_SIZE);
+        int tx1 = floorDiv(cfg.pattern_offset_x + pattern.width - 1, SPARSE_TILE_SIZE);
+        int band_width = (tx1 - tx0 + 1) * SPARSE_TILE_SIZE;
+        unsigned char* band = malloc((size_t)SPARSE_TILE_SIZE * band_width);
+        if (band == NULL) {
+            fprintf(stderr, "Failed to allocate memory for the pattern\n");
+            exit(1);
+        }
+        unsigned char** rows = createGridView(band, SPARSE_TILE_SIZE, band_width);
+        for (int ty = ty0; ty <= ty1; ty++) {
+            memset(band, 0, (size_t)SPARSE_TILE_SIZE * band_width);
+            placePatternRows(&pattern, cfg.pattern_offset_y - ty * SPARSE_TILE_SIZE, cfg.pattern_offset_x - tx0 * SPARSE_TILE_SIZE,
+                0, SPARSE_TILE_SIZE, rows, band_width);
+            for (int tx = tx0; tx <= tx1; tx++) {
+                if (tileOwner(universe, ty, tx) != universe->rank) {
+                    continue;
+                }
+                int column = (tx - tx0) * SPARSE_TILE_SIZE;
+                unsigned char alive = 0;
+                for (int y = 0; y < SPARSE_TILE_SIZE; y++) {
+                    for (int x = 0; x < SPARSE_TILE_SIZE; x++) {
+                        alive |= rows[y][column + x];
+                    }
+                }
+                if (alive) {
+                    SparseTile* tile = createTile(&universe->tiles, ty, tx);
+                    for (int y = 0; y < SPARSE_TILE_SIZE; y++) {
+                        memcpy(tileCell(tile, universe->current, y, 0), &rows[y][column], SPARSE_TILE_SIZE);
+                    }
+                }
+            }
+        }
+        freeGridView(rows);
+        free(band);
+    }
+    closePattern(&pattern);
+}
+
+static void fillRandom(SparseUniverse* universe, WorkerConfig cfg) {
+    int size = cfg.grid_width;
+    int tiles = (size + SPARSE_TILE_SIZE - 1) / SPARSE_TILE_SIZE;
+    for (int ty = 0; ty < tiles; ty++) {
+        for (int tx = 0; tx < tiles; tx++) {
+            if (tileOwner(universe, ty, tx) != universe->rank) {
+                continue;
+            }
+            SparseTile* tile = createTile(&universe->tiles, ty, tx);
+            for (int y = 0; y < SPARSE_TILE_SIZE; y++) {
+                for (int x = 0; x < SPARSE_TILE_SIZE; x++) {
+                    int cell_y = ty * SPARSE_TILE_SIZE + y;
+                    int cell_x = tx * SPARSE_TILE_SIZE + x;
+                    if (cell_y < size && cell_x < size) {
+                        *tileCell(tile, universe->current, y, x) = hashedRandomCell(cfg.seed, (long long)cell_y * size + cell_x, SPARSE_DENSITY);
+                    }
+                }
+            }
+            if (!tileIsAlive(tile, universe->current)) {
+                removeTile(&universe->tiles, tile);
+            }
+        }
+    }
+}
+
+
+void initSparseUniverse(SparseUniverse* universe, WorkerConfig cfg, MPI_Comm worker_comm) {
+    memset(universe, 0, sizeof(*universe));
+    universe->comm = worker_comm;
+    MPI_Comm_rank(worker_comm, &universe->rank);
+    MPI_Comm_size(worker_comm, &universe->workers);
+    universe->updateRow = updateKernels[chooseTileKernel(cfg.kernel, cfg.world_rank)].updateRow;
+    initTileMap(&universe->tiles);
+
+    universe->send_counts = calloc(universe->workers, sizeof(int));
+    universe->send_displs = calloc(universe->workers, sizeof(int));
+    universe->receive_counts = calloc(universe->workers, sizeof(int));
+    universe->receive_displs = calloc(universe->workers, sizeof(int));
+    if (universe->send_counts == NULL || universe->send_displs == NULL || universe->receive_counts == NULL || universe->receive_displs == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the border exchange\n");
+        exit(1);
+    }
+
+    if (cfg.pattern_file[0] != '\0') {
+        fillFromPattern(universe, cfg);
+    } else {
+        fillRandom(universe, cfg);
+    }
+    universe->max_tiles = universe->tiles.count;
+}
+
+
+void freeSparseUniverse(SparseUniverse* universe) {
+    freeTileMap(&universe->tiles);
+    free(universe->send_buffer);
+    free(universe->receive_buffer);
+    free(universe->send_counts);
+    free(universe->send_displs);
+    free(universe->receive_counts);
+    free(universe->receive_displs);
+}
+
+
+/**
+ * Makes the buffer hold at least size bytes
+ */
+static void reserveBuffer(unsigned char** buffer, size_t* capacity, size_t size) {
+    if (size <= *capacity) {
+        return;
+    }
+    *capacity = size > 2 * *capacity ? size : 2 * *capacity;
+    free(*buffer);
+    *buffer = malloc(*capacity);
+    if (*buffer == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the border exchange\n");
+        exit(1);
+    }
+}
+
+
+void exchangeSparseBorders(SparseUniverse* universe) {
+    SparseTileMap* map = &universe->tiles;
+    int generation = universe->current;
+    const int strip_size = sizeof(SparseStrip);
+    SparseStrip strip;
+
+    // count the strips per owner first, so they can be written in rank order
+    memset(universe->send_counts, 0, universe->workers * sizeof(int));
+    for (size_t i = 0; i < map->capacity; i++) {
+        SparseTile* tile = map->slots[i];
+        for (int d = 0; tile != NULL && d < 9; d++) {
+            int dy = d / 3 - 1, dx = d % 3 - 1;
+            if ((dy != 0 || dx != 0) && extractStrip(tile, generation, dy, dx, &strip)) {
+                universe->send_counts[tileOwner(universe, strip.ty, strip.tx)] += strip_size;
+            }
+        }
+    }
+    size_t total = 0;
+    for (int r = 0; r < universe->workers; r++) {
+        universe->send_displs[r] = total;
+        total += universe->send_counts[r];
+        if (r != universe->rank) {
+            universe->bytes_sent += universe->send_counts[r];
+        }
+    }
+    reserveBuffer(&universe->send_buffer, &universe->send_capacity, total);
+    int offsets[universe->workers];
+    memcpy(offsets, universe->send_displs, universe->workers * sizeof(int));
+    for (size_t i = 0; i < map->capacity; i++) {
+        SparseTile* tile = map->slots[i];
+        for (int d = 0; tile != NULL && d < 9; d++) {
+            int dy = d / 3 - 1, dx = d % 3 - 1;
+            if ((dy != 0 || dx != 0) && extractStrip(tile, generation, dy, dx, &strip)) {
+                int owner = tileOwner(universe, strip.ty, strip.tx);
+                memcpy(universe->send_buffer + offsets[owner], &strip, strip_size);
+                offsets[owner] += strip_size;
+            }
+        }
+    }
+
+    MPI_Alltoall(universe->send_counts, 1, MPI_INT, universe->receive_counts, 1, MPI_INT, universe->comm);
+    size_t received = 0;
+    for (int r = 0; r < universe->workers; r++) {
+        universe->receive_displs[r] = received;
+        received += universe->receive_counts[r];
+    }
+    reserveBuffer(&universe->receive_buffer, &universe->receive_capacity, received);
+    MPI_Alltoallv(universe->send_buffer, universe->send_counts, universe->send_displs, MPI_BYTE,
+        universe->receive_buffer, universe->receive_counts, universe->receive_displs, MPI_BYTE, universe->comm);
+
+    // the ghost rings of the last generation are outdated, tiles without a neighbor border see dead cells
+    for (size_t i = 0; i < map->capacity; i++) {
+        if (map->slots[i] != NULL) {
+            clearGhostRing(map->slots[i], generation);
+        }
+    }
+    for (size_t offset = 0; offset < received; offset += strip_size) {
+        memcpy(&strip, universe->receive_buffer + offset, strip_size);
+        SparseTile* tile = findTile(map, strip.ty, strip.tx);
+        if (tile == NULL) {
+            tile = createTile(map, strip.ty, strip.tx);
+        }
+        applyStrip(tile, generation, &strip);
+    }
+    if (map->count > universe->max_tiles) {
+        universe->max_tiles = map->count;
+    }
+}
+
+
+void updateSparseTiles(SparseUniverse* universe) {
+    SparseTileMap* map = &universe->tiles;
+    int current = universe->current;
+    int next = 1 - current;
+    SparseTile** dead = malloc((map->count + 1) * sizeof(SparseTile*));
+    if (dead == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the dead tiles\n");
+        exit(1);
+    }
+    size_t dead_count = 0;
+    for (size_t i = 0; i < map->capacity; i++) {
+        SparseTile* tile = map->slots[i];
+        if (tile == NULL) {
+            continue;
+        }
+        const unsigned char* cells = tile->cells[current];
+        unsigned char* next_cells = tile->cells[next];
+        for (int y = 1; y <= SPARSE_TILE_SIZE; y++) {
+            universe->updateRow(cells + (y - 1) * SPARSE_TILE_STRIDE, cells + y * SPARSE_TILE_STRIDE, cells + (y + 1) * SPARSE_TILE_STRIDE,
+                next_cells + y * SPARSE_TILE_STRIDE, SPARSE_TILE_STRIDE, 1, SPARSE_TILE_SIZE + 1);
+        }
+        if (!tileIsAlive(tile, next)) {
+            dead[dead_count++] = tile;
+        }
+    }
+    // removing moves tiles between slots, so not while iterating over them
+    for (size_t i = 0; i < dead_count; i++) {
+        removeTile(map, dead[i]);
+    }
+    free(dead);
+    universe->current = next;
+}
+
+
+void writeSparseImage(const SparseUniverse* universe, const char* label, int iterations) {
+    // every tile is sent with its coordinate
+    const int record_size = 2 * sizeof(int) + SPARSE_TILE_SIZE * SPARSE_TILE_SIZE;
+    int world_rank, world_size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    int send_size = 0;
+    unsigned char* records = NULL;
+    if (universe != NULL) {
+        send_size = universe->tiles.count * record_size;
+        records = malloc(send_size + 1);
+        if (records == NULL) {
+            fprintf(stderr, "Failed to allocate memory for the image\n");
+            exit(1);
+        }
+        unsigned char* record = records;
+        for (size_t i = 0; i < universe->tiles.capacity; i++) {
+            SparseTile* tile = universe->tiles.slots[i];
+            if (tile == NULL) {
+                continue;
+            }
+            memcpy(record, &tile->ty, sizeof(int));
+            memcpy(record + sizeof(int), &tile->tx, sizeof(int));
+            for (int y = 0; y < SPARSE_TILE_SIZE; y++) {
+                memcpy(record + 2 * sizeof(int) + y * SPARSE_TILE_SIZE, tileCell(tile, universe->current, y, 0), SPARSE_TILE_SIZE);
+            }
+            record += record_size;
+        }
+    }
+
+    int counts[world_size], displs[world_size];
+    MPI_Gather(&send_size, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    unsigned char* all_records = NULL;
+    size_t total = 0;
+    if (world_rank == 0) {
+        for (int r = 0; r < world_size; r++) {
+            displs[r] = total;
+            total += counts[r];
+        }
+        all_records = malloc(total + 1);
+        if (all_records == NULL) {
+            fprintf(stderr, "Failed to allocate memory for the image\n");
+            exit(1);
+        }
+    }
+    MPI_Gatherv(records, send_size, MPI_BYTE, all_records, counts, displs, MPI_BYTE, 0, MPI_COMM_WORLD);
+    free(records);
+    if (world_rank != 0) {
+        return;
+    }
+
+    size_t tile_count = total / record_size;
+    int min_ty = INT_MAX, max_ty = INT_MIN, min_tx = INT_MAX, max_tx = INT_MIN;
+    long long population = 0;
+    for (size_t i = 0; i < tile_count; i++) {
+        int ty, tx;
+        const unsigned char* record = all_records + i * record_size;
+        memcpy(&ty, record, sizeof(int));
+        memcpy(&tx, record + sizeof(int), sizeof(int));
+        min_ty = ty < min_ty ? ty : min_ty;
+        max_ty = ty > max_ty ? ty : max_ty;
+        min_tx = tx < min_tx ? tx : min_tx;
+        max_tx = tx > max_tx ? tx : max_tx;
+        for (int c = 0; c < SPARSE_TILE_SIZE * SPARSE_TILE_SIZE; c++) {
+            population += record[2 * sizeof(int) + c];
+        }
+    }
+    if (tile_count == 0) {
+        printf("Master process: %s universe has no alive cells\n", label);
+        free(all_records);
+        return;
+    }
+    long long height = (long long)(max_ty - min_ty + 1) * SPARSE_TILE_SIZE;
+    long long width = (long long)(max_tx - min_tx + 1) * SPARSE_TILE_SIZE;
+    printf("Master process: %s universe has %lld alive cells in %zu tiles, cells %lld..%lld x %lld..%lld\n", label, population, tile_count,
+        (long long)min_ty * SPARSE_TILE_SIZE, (long long)min_ty * SPARSE_TILE_SIZE + height - 1, (long long)min_tx * SPARSE_TILE_SIZE, (long long)min_tx * SPARSE_TILE_SIZE + width - 1);
+    if (height > SPARSE_IMAGE_MAX || width > SPARSE_IMAGE_MAX) {
+        printf("Warning: the image is cropped to the first %d rows and columns of the universe\n", SPARSE_IMAGE_MAX);
+        height = height > SPARSE_IMAGE_MAX ? SPARSE_IMAGE_MAX : height;
+        width = width > SPARSE_IMAGE_MAX ? SPARSE_IMAGE_MAX : width;
+    }
+
+    unsigned char* image = calloc(height * width, 1);
+    if (image == NULL) {
+        fprintf(stderr, "Failed to allocate memory for the image\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < tile_count; i++) {
+        int ty, tx;
+        const unsigned char* record = all_records + i * record_size;
+        memcpy(&ty, record, sizeof(int));
+        memcpy(&tx, record + sizeof(int), sizeof(int));
+        long long top = (long long)(ty - min_ty) * SPARSE_TILE_SIZE;
+        long long left = (long long)(tx - min_tx) * SPARSE_TILE_SIZE;
+        if (top >= height || left >= width) {
+            continue;
+        }
+        for (int y = 0; y < SPARSE_TILE_SIZE && top + y < height; y++) {
+            memcpy(image + (top + y) * width + left, record + 2 * sizeof(int) + y * SPARSE_TILE_SIZE,
+                left + SPARSE_TILE_SIZE <= width ? SPARSE_TILE_SIZE : width - left);
+        }
+    }
+    char file_name_buffer[80];
+    snprintf(file_name_buffer, 80, "mpi_%s_sparse-%d-%lldx%lld.jpg", label, iterations, width, height);
+    unsigned char** view = createGridView(image, height, width);
+    write_jpeg_file(file_name_buffer, view, width, height);
+    freeGridView(view);
+    free(image);
+    free(all_records);
+}
+
+
+void runSparseMaster(const GameConfig* cfg) {
+    double start_time = MPI_Wtime();
+    PerfCounters counters;
+    openPerfCounters(&counters, cfg->counters);
+    startCounterPhase(&counters, COUNTER_PHASE_IO);
+    writeSparseImage(NULL, "initial", cfg->total_iterations);
+    writeSparseImage(NULL, "result", cfg->total_iterations);
+    stopCounterPhase(&counters);
+    if (cfg->counters) {
+        long long cells[COUNTER_PHASE_COUNT] = {0, 0, 2LL * cfg->width * cfg->height};
+        reportPerfCounters(&counters, MPI_COMM_SELF, cells, "Master process");
+    }
+    closePerfCounters(&counters);
+    printf("Master process time: %f seconds\n", MPI_Wtime() - start_time);
+}
+
+
+void runSparseWorker(WorkerConfig cfg, MPI_Comm worker_comm) {
+    double start_time = MPI_Wtime();
+    WorkerPlacement placement;
+    placeWorker(&placement, worker_comm, cfg.pin);
+    SparseUniverse universe;
+    initSparseUniverse(&universe, cfg, worker_comm);
+    PerfCounters counters;
+    openPerfCounters(&counters, cfg.counters);
+    printf("Worker process %2d: cpu %d, numa node %d, %s, %zu tiles of %dx%d cells\n", cfg.world_rank, placement.cpu, placement.numa_node,
+        placement.pinned ? "pinned" : "not pinned", universe.tiles.count, SPARSE_TILE_SIZE, SPARSE_TILE_SIZE);
+
+    startCounterPhase(&counters, COUNTER_PHASE_IO);
+    long long io_cells = (long long)universe.tiles.count * SPARSE_TILE_SIZE * SPARSE_TILE_SIZE;
+    writeSparseImage(&universe, "initial", cfg.total_iterations);
+    stopCounterPhase(&counters);
+
+    MPI_Barrier(worker_comm); // Barrier operation for workers only, to make them start at the same time
+
+    double update_time = 0, halo_time = 0;
+    long long updated_cells = 0, ghost_cells = 0;
+    for (int i = 0; i < cfg.total_iterations; i++) {
+        double phase_start = MPI_Wtime();
+        startCounterPhase(&counters, COUNTER_PHASE_HALO);
+        exchangeSparseBorders(&universe);
+        stopCounterPhase(&counters);
+        double phase_mid = MPI_Wtime();
+        startCounterPhase(&counters, COUNTER_PHASE_UPDATE);
+        updated_cells += (long long)universe.tiles.count * SPARSE_TILE_SIZE * SPARSE_TILE_SIZE;
+        ghost_cells += (long long)universe.tiles.count * 4 * (SPARSE_TILE_SIZE + 1); // the ghost rings
+        updateSparseTiles(&universe);
+        stopCounterPhase(&counters);
+        halo_time += phase_mid - phase_start;
+        update_time += MPI_Wtime() - phase_mid;
+    }
+
+    startCounterPhase(&counters, COUNTER_PHASE_IO);
+    io_cells += (long long)universe.tiles.count * SPARSE_TILE_SIZE * SPARSE_TILE_SIZE;
+    writeSparseImage(&universe, "result", cfg.total_iterations);
+    stopCounterPhase(&counters);
+
+    double end_time = MPI_Wtime();
+    printf("Worker process %2d time: %f seconds timePerIteration: %f ms update: %f ms halo (sparse): %f ms %.1f bytes sent, %zu tiles, at most %zu\n", cfg.world_rank,
+        end_time - start_time, (end_time - start_time) / cfg.total_iterations * 1000, update_time / cfg.total_iterations * 1000,
+        halo_time / cfg.total_iterations * 1000, (double)universe.bytes_sent / cfg.total_iterations, universe.tiles.count, universe.max_tiles);
+
+    if (cfg.counters) {
+        long long cells[COUNTER_PHASE_COUNT] = {updated_cells, ghost_cells, io_cells};
+        reportPerfCounters(&counters, worker_comm, cells, "Workers");
+    }
+    closePerfCounters(&counters);
+    freeSparseUniverse(&universe);
+}
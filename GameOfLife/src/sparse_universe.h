@@ -0,0 +1,137 @@
+#pragma once
+
+#include <mpi.h>
+#include <stddef.h>
+
+#include "arg_parser.h"
+#include "game_of_life_mpi.h"
+#include "kernel_registry.h"
+
+// cells per side of a tile
+#define SPARSE_TILE_SIZE 64
+// a tile with its ghost ring
+#define SPARSE_TILE_STRIDE (SPARSE_TILE_SIZE + 2)
+// the ownership hash keeps blocks of 2^SPARSE_BLOCK_BITS x 2^SPARSE_BLOCK_BITS tiles on one worker
+#define SPARSE_BLOCK_BITS 2
+// largest side of the images, larger universes are cropped
+#define SPARSE_IMAGE_MAX 8192
+
+/**
+ * How the grid is stored
+ */
+enum Universe {
+    UNIVERSE_DENSE = 0, // height x width cells with dead borders, split into row strips
+    UNIVERSE_SPARSE = 1 // unbounded, only the tiles with alive cells exist
+};
+
+int parseUniverse(const char* name);
+const char* universeName(int universe);
+
+/**
+ * A dense tile of the sparse universe, both generations with a ghost ring of one cell
+ *
+ * @param ty The tile row, the tile holds the cells ty * SPARSE_TILE_SIZE to ty * SPARSE_TILE_SIZE + SPARSE_TILE_SIZE - 1
+ * @param tx The tile column
+ * @param cells The two generations, SPARSE_TILE_STRIDE x SPARSE_TILE_STRIDE cells each
+ */
+struct SparseTile {
+    int ty;
+    int tx;
+    unsigned char cells[2][SPARSE_TILE_STRIDE * SPARSE_TILE_STRIDE];
+};
+typedef struct SparseTile SparseTile;
+
+/**
+ * Open addressing hash map from the tile coordinate to the tile, with linear probing
+ *
+ * @param slots The tiles, NULL for a free slot
+ * @param capacity The number of slots, a power of two
+ * @param count The number of tiles
+ */
+struct SparseTileMap {
+    SparseTile** slots;
+    size_t capacity;
+    size_t count;
+};
+typedef struct SparseTileMap SparseTileMap;
+
+/**
+ * The tiles a worker owns. A tile is owned by the worker the hash of its block in Morton order points to
+ *
+ * @param tiles The owned tiles
+ * @param current The generation index into the cells of every tile
+ * @param comm The communicator of the workers
+ * @param rank The rank in comm
+ * @param workers The size of comm
+ * @param updateRow The update kernel
+ * @param send_buffer The border strips for the other workers, in rank order
+ * @param send_capacity The size of send_buffer in bytes
+ * @param receive_buffer The border strips from the other workers
+ * @param receive_capacity The size of receive_buffer in bytes
+ * @param send_counts Bytes per worker, and the displacements of the MPI_Alltoallv
+ * @param bytes_sent Strip bytes sent to other workers over all generations
+ * @param max_tiles The most tiles the worker had at once
+ */
+struct SparseUniverse {
+    SparseTileMap tiles;
+    int current;
+
+    MPI_Comm comm;
+    int rank;
+    int workers;
+    UpdateRowFunction updateRow;
+
+    unsigned char* send_buffer;
+    size_t send_capacity;
+    unsigned char* receive_buffer;
+    size_t receive_capacity;
+    int* send_counts;
+    int* send_displs;
+    int* receive_counts;
+    int* receive_displs;
+
+    long long bytes_sent;
+    size_t max_tiles;
+};
+typedef struct SparseUniverse SparseUniverse;
+
+/**
+ * Creates the tiles of the worker, from the pattern of cfg or a random square of grid_width cells with its corner at 0,0
+ *
+ * @param universe The universe to initialize
+ * @param cfg The worker process Config
+ * @param worker_comm The communicator of all workers
+ */
+void initSparseUniverse(SparseUniverse* universe, WorkerConfig cfg, MPI_Comm worker_comm);
+
+void freeSparseUniverse(SparseUniverse* universe);
+
+/**
+ * Sends the non-empty borders of every tile to the owners of the 8 neighboring tiles with one MPI_Alltoallv.
+ * A worker that receives a border for a tile it does not have creates the tile, that is how activity spreads
+ */
+void exchangeSparseBorders(SparseUniverse* universe);
+
+/**
+ * Computes the next generation of every tile and frees the tiles that died
+ */
+void updateSparseTiles(SparseUniverse* universe);
+
+/**
+ * Collective over MPI_COMM_WORLD: the main process receives all tiles and writes the bounding box of the alive tiles as jpeg image
+ *
+ * @param universe The universe of the worker, NULL on the main process
+ * @param label Part of the file name
+ * @param iterations Part of the file name
+ */
+void writeSparseImage(const SparseUniverse* universe, const char* label, int iterations);
+
+/**
+ * Runs the sparse universe on the main process, it only writes the images
+ */
+void runSparseMaster(const GameConfig* cfg);
+
+/**
+ * Runs the sparse universe on a worker, called with the config from distributeAndSendConfig
+ */
+void runSparseWorker(WorkerConfig cfg, MPI_Comm worker_comm);
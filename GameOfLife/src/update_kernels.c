@@ -0,0 +1,217 @@
+#include "kernel_registry.h"
+
+#include <stdint.h>
+#include <string.h> // memcpy
+
+#if defined(__x86_64__) || defined(__i386__)
+#define UPDATE_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+
+/**
+ * Next state of one cell with bounds checks for the first and last column
+ */
+static inline unsigned char nextCellState(const unsigned char* above, const unsigned char* row, const unsigned char* below, int width, int j) {
+    int left = j > 0 ? j - 1 : j;
+    int right = j < width - 1 ? j + 1 : j;
+    int liveNeighbors = -row[j];
+    for (int x = left; x <= right; x++) {
+        liveNeighbors += above[x] + row[x] + below[x];
+    }
+    // a dead cell with 3 neighbors is born, an alive cell with 2 or 3 neighbors survives
+    return (liveNeighbors | row[j]) == 3;
+}
+
+
+static void updateRowScalar(const unsigned char* above, const unsigned char* row, const unsigned char* below, unsigned char* next, int width, int first_column, int last_column) {
+    for (int j = first_column; j < last_column; j++) {
+        next[j] = nextCellState(above, row, below, width, j);
+    }
+}
+
+
+#ifdef UPDATE_KERNELS_X86
+
+static bool supportsSse2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+}
+
+static bool supportsAvx2(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+static bool supportsAvx512(void) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512bw");
+}
+
+
+/*
+ * The vector kernels add the 8 neighbors of 16, 32 or 64 cells with unaligned loads shifted by one column.
+ * The first and last column miss a neighbor, they and the columns left over by the vectors are updated by nextCellState
+ */
+
+__attribute__((target("sse2")))
+static void updateRowSse2(const unsigned char* above, const unsigned char* row, const unsigned char* below, unsigned char* next, int width, int first_column, int last_column) {
+    int j = first_column;
+    if (j == 0) {
+        next[0] = nextCellState(above, row, below, width, 0);
+        j = 1;
+    }
+    int vector_end = last_column < width - 1 ? last_column : width - 1;
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i three = _mm_set1_epi8(3);
+    for (; j + 16 <= vector_end; j += 16) {
+        __m128i sum = _mm_add_epi8(_mm_loadu_si128((const __m128i*)(above + j - 1)), _mm_loadu_si128((const __m128i*)(above + j)));
+        sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i*)(above + j + 1)));
+        sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i*)(row + j - 1)));
+        sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i*)(row + j + 1)));
+        sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i*)(below + j - 1)));
+        sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i*)(below + j)));
+        sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i*)(below + j + 1)));
+        __m128i alive = _mm_loadu_si128((const __m128i*)(row + j));
+        __m128i result = _mm_and_si128(_mm_cmpeq_epi8(_mm_or_si128(sum, alive), three), one);
+        _mm_storeu_si128((__m128i*)(next + j), result);
+    }
+    for (; j < last_column; j++) {
+        next[j] = nextCellState(above, row, below, width, j);
+    }
+}
+
+
+__attribute__((target("avx2")))
+static void updateRowAvx2(const unsigned char* above, const unsigned char* row, const unsigned char* below, unsigned char* next, int width, int first_column, int last_column) {
+    int j = first_column;
+    if (j == 0) {
+        next[0] = nextCellState(above, row, below, width, 0);
+        j = 1;
+    }
+    int vector_end = last_column < width - 1 ? last_column : width - 1;
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i three = _mm256_set1_epi8(3);
+    for (; j + 32 <= vector_end; j += 32) {
+        __m256i sum = _mm256_add_epi8(_mm256_loadu_si256((const __m256i*)(above + j - 1)), _mm256_loadu_si256((const __m256i*)(above + j)));
+        sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i*)(above + j + 1)));
+        sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i*)(row + j - 1)));
+        sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i*)(row + j + 1)));
+        sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i*)(below + j - 1)));
+        sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i*)(below + j)));
+        sum = _mm256_add_epi8(sum, _mm256_loadu_si256((const __m256i*)(below + j + 1)));
+        __m256i alive = _mm256_loadu_si256((const __m256i*)(row + j));
+        __m256i result = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_or_si256(sum, alive), three), one);
+        _mm256_storeu_si256((__m256i*)(next + j), result);
+    }
+    for (; j < last_column; j++) {
+        next[j] = nextCellState(above, row, below, width, j);
+    }
+}
+
+
+__attribute__((target("avx512f,avx512bw")))
+static void updateRowAvx512(const unsigned char* above, const unsigned char* row, const unsigned char* below, unsigned char* next, int width, int first_column, int last_column) {
+    int j = first_column;
+    if (j == 0) {
+        next[0] = nextCellState(above, row, below, width, 0);
+        j = 1;
+    }
+    int vector_end = last_column < width - 1 ? last_column : width - 1;
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i three = _mm512_set1_epi8(3);
+    for (; j + 64 <= vector_end; j += 64) {
+        __m512i sum = _mm512_add_epi8(_mm512_loadu_si512(above + j - 1), _mm512_loadu_si512(above + j));
+        sum = _mm512_add_epi8(sum, _mm512_loadu_si512(above + j + 1));
+        sum = _mm512_add_epi8(sum, _mm512_loadu_si512(row + j - 1));
+        sum = _mm512_add_epi8(sum, _mm512_loadu_si512(row + j + 1));
+        sum = _mm512_add_epi8(sum, _mm512_loadu_si512(below + j - 1));
+        sum = _mm512_add_epi8(sum, _mm512_loadu_si512(below + j));
+        sum = _mm512_add_epi8(sum, _mm512_loadu_si512(below + j + 1));
+        __m512i alive = _mm512_loadu_si512(row + j);
+        __mmask64 born_or_alive = _mm512_cmpeq_epi8_mask(_mm512_or_si512(sum, alive), three);
+        _mm512_storeu_si512(next + j, _mm512_maskz_mov_epi8(born_or_alive, one));
+    }
+    for (; j < last_column; j++) {
+        next[j] = nextCellState(above, row, below, width, j);
+    }
+}
+
+#endif // UPDATE_KERNELS_X86
+
+
+/**
+ * Bit i of the result is the cell in column + i, count cells starting at column
+ */
+static inline uint64_t loadCellBits(const unsigned char* row, int column, int count) {
+    uint64_t bits = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // the multiplication moves the lowest bit of every byte into the highest byte
+        uint64_t bytes;
+        memcpy(&bytes, row + column + i, 8);
+        bits |= ((bytes * 0x0102040810204080ULL) >> 56) << i;
+    }
+    for (; i < count; i++) {
+        bits |= (uint64_t)(row[column + i] & 1) << i;
+    }
+    return bits;
+}
+
+static inline void fullAdder(uint64_t a, uint64_t b, uint64_t c, uint64_t* sum, uint64_t* carry) {
+    *sum = a ^ b ^ c;
+    *carry = (a & b) | (c & (a ^ b));
+}
+
+/**
+ * Loads the cells of a word and shifts them by one column in both directions
+ */
+static inline void loadNeighborBits(const unsigned char* row, int width, int column, int count, uint64_t* west, uint64_t* center, uint64_t* east) {
+    *center = loadCellBits(row, column, count);
+    uint64_t left = column > 0 ? row[column - 1] & 1 : 0;
+    uint64_t right = column + count < width ? row[column + count] & 1 : 0;
+    *west = (*center << 1) | left;
+    *east = (*center >> 1) | (right << (count - 1));
+}
+
+
+static void updateRowBitpacked(const unsigned char* above, const unsigned char* row, const unsigned char* below, unsigned char* next, int width, int first_column, int last_column) {
+    for (int column = first_column; column < last_column; column += 64) {
+        int count = last_column - column < 64 ? last_column - column : 64;
+        uint64_t above_west, above_center, above_east, row_west, alive, row_east, below_west, below_center, below_east;
+        loadNeighborBits(above, width, column, count, &above_west, &above_center, &above_east);
+        loadNeighborBits(row, width, column, count, &row_west, &alive, &row_east);
+        loadNeighborBits(below, width, column, count, &below_west, &below_center, &below_east);
+
+        // count the 8 neighbors of all 64 cells at once: ones + 2 * (sum of the carries)
+        uint64_t sum_above, carry_above, sum_below, carry_below, ones, carry_ones;
+        fullAdder(above_west, above_center, above_east, &sum_above, &carry_above);
+        fullAdder(below_west, below_center, below_east, &sum_below, &carry_below);
+        uint64_t sum_row = row_west ^ row_east;
+        uint64_t carry_row = row_west & row_east;
+        fullAdder(sum_above, sum_below, sum_row, &ones, &carry_ones);
+        uint64_t twos = carry_above ^ carry_below ^ carry_row ^ carry_ones;
+        uint64_t four_or_more = (carry_above & carry_below) | (carry_above & carry_row) | (carry_above & carry_ones)
+                              | (carry_below & carry_row) | (carry_below & carry_ones) | (carry_row & carry_ones);
+        uint64_t result = twos & ~four_or_more & (ones | alive); // 3 neighbors, or 2 neighbors and alive
+
+        for (int i = 0; i < count; i++) {
+            next[column + i] = (result >> i) & 1;
+        }
+    }
+}
+
+
+const UpdateKernel updateKernels[UPDATE_KERNEL_COUNT] = {
+    [UPDATE_KERNEL_SCALAR] = {"scalar", NULL, updateRowScalar},
+#ifdef UPDATE_KERNELS_X86
+    [UPDATE_KERNEL_SSE2] = {"sse2", supportsSse2, updateRowSse2},
+    [UPDATE_KERNEL_AVX2] = {"avx2", supportsAvx2, updateRowAvx2},
+    [UPDATE_KERNEL_AVX512] = {"avx512", supportsAvx512, updateRowAvx512},
+#else
+    [UPDATE_KERNEL_SSE2] = {"sse2", NULL, NULL},
+    [UPDATE_KERNEL_AVX2] = {"avx2", NULL, NULL},
+    [UPDATE_KERNEL_AVX512] = {"avx512", NULL, NULL},
+#endif
+    [UPDATE_KERNEL_BITPACKED] = {"bitpacked", NULL, updateRowBitpacked},
+};
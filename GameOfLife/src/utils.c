@@ -32,8 +32,8 @@ unsigned char** readGridFromFile(char* name, int height, int width, int iteratio
 
     unsigned char** grid = createGrid(height, width);
     for (int i = 0; i < height; i++) {
-        char line[width];
-        fgets(line, width + 1, filePointer);
+        char line[width + 2]; // the row, the line break and the terminating null byte
+        fgets(line, width + 2, filePointer);
         for (int j = 0; j < width; j++) {
             grid[i][j] = line[j] == '1' ? 1 : 0;
         }
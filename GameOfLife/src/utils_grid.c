@@ -1,3 +1,4 @@
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h> // malloc, free, rand
 #include <time.h>
@@ -13,7 +14,7 @@ unsigned char** createGrid(int height, int width) {
 }
 
 unsigned char* createGridSingleBlock(int height, int width) {
-    unsigned char* grid = malloc(height * width * sizeof(unsigned char *));
+    unsigned char* grid = malloc((size_t)height * width * sizeof(unsigned char));
     if (grid == NULL) {
         printf("Memory allocation failed\n");
         exit(1);
@@ -21,6 +22,22 @@ unsigned char* createGridSingleBlock(int height, int width) {
     return grid;
 }
 
+unsigned char** createGridView(unsigned char* block, int height, int width) {
+    unsigned char** grid = malloc(height * sizeof(unsigned char *));
+    if (grid == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < height; i++) {
+        grid[i] = block + (size_t)i * width;
+    }
+    return grid;
+}
+
+void freeGridView(unsigned char** grid) {
+    free(grid);
+}
+
 void freeGrid(unsigned char** grid, int height) {
     for (int i = 0; i < height; i++) {
         free(grid[i]);
@@ -48,6 +65,14 @@ void initializeGridRandom(unsigned char** grid, int height, int width, float den
     }
 }
 
+void initializeGridHashed(unsigned char** grid, int height, int width, int seed, float density) {
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < width; j++) {
+            grid[i][j] = hashedRandomCell(seed, (long long)i * width + j, density);
+        }
+    }
+}
+
 void initializeGridRandom1D(unsigned char* grid, int height, int width, float density) {
     srand(time(NULL)); // Seed the random number generator with current time
     
@@ -59,6 +84,14 @@ void initializeGridRandom1D(unsigned char* grid, int height, int width, float de
     }
 }
 
+unsigned char hashedRandomCell(int seed, long long position, float density) {
+    uint64_t hash = (uint64_t)position * 0x9E3779B97F4A7C15ULL + (uint32_t)seed;
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+    return (hash >> 11) * (1.0 / 9007199254740992.0) < density;
+}
+
 void initializeGridModulo(unsigned char** grid, int height, int width, int modulo) {    
     for (int i = 0; i < height; i++) {
         for (int j = 0; j < width; j++) {
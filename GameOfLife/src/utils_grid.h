@@ -20,6 +20,26 @@ unsigned char** createGrid(int height, int width);
 unsigned char* createGridSingleBlock(int height, int width);
 
 
+/**
+ * Create the row pointers of a grid whose rows are stored one after another in the given block.
+ * The block is not owned by the grid, free it with freeGridView and release the block separately
+ * 
+ * @param block the memory block with at least height * width bytes
+ * @param height the height of the grid
+ * @param width the width of the grid
+ * @return the created grid
+*/
+unsigned char** createGridView(unsigned char* block, int height, int width);
+
+
+/**
+ * Free the row pointers of a grid created with createGridView
+ * 
+ * @param grid the grid to free
+*/
+void freeGridView(unsigned char** grid);
+
+
 /**
  * Free the memory of the grid
  * 
@@ -41,8 +61,26 @@ void initializeGridZero(unsigned char** grid, int height, int width);
 */
 void initializeGridRandom(unsigned char** grid, int height, int width, float density);
 
+/**
+ * Initialize the grid with hashedRandomCell, the same cells the workers create from the seed
+ *
+ * @param seed the seed
+*/
+void initializeGridHashed(unsigned char** grid, int height, int width, int seed, float density);
+
 void initializeGridRandom1D(unsigned char* grid, int height, int width, float density);
 
+/**
+ * A random cell that only depends on the seed and its position, so every process can create its part
+ * of a random grid without rand (splitmix64)
+ *
+ * @param seed the seed
+ * @param position the global index of the cell
+ * @param density the probability of an alive cell
+ * @return 1 if the cell is alive
+*/
+unsigned char hashedRandomCell(int seed, long long position, float density);
+
 void initializeGridModulo(unsigned char** grid, int height, int width, int modulo);
 
 void initializeGridSpaceCraft(unsigned char** grid, int height, int width, int offsety, int offsetx);
@@ -0,0 +1,49 @@
+#!/bin/bash
+# The census of a grid with one block, blinker, toad, beacon and lwss has to find each of them in every generation,
+# also in the phases of the toad, the beacon and the lwss that are not 8-connected. The beacon crosses the rows of the two workers.
+# usage: census_test.sh <GameOfLife executable> [mpirun]
+set -e
+executable=$(realpath "$1")
+mpirun=${2:-mpirun}
+flags=""
+if "$mpirun" --version 2>&1 | grep -q "Open MPI"; then
+    flags="--oversubscribe"
+    if [ "$(id -u)" = 0 ]; then
+        flags="$flags --allow-run-as-root"
+    fi
+fi
+
+directory=$(mktemp -d)
+trap 'rm -rf "$directory"' EXIT
+cd "$directory"
+python3 - <<'PATTERN'
+grid = [["."] * 48 for _ in range(48)]
+def place(row, column, shape):
+    for r, line in enumerate(shape.split("/")):
+        for c, cell in enumerate(line):
+            if cell == "o":
+                grid[row + r][column + c] = "O"
+place(3, 3, "oo/oo")
+place(3, 15, "ooo")
+place(10, 5, ".ooo/ooo.")
+place(22, 20, "oo../oo../..oo/..oo")
+place(35, 30, ".o..o/o..../o...o/oooo.")
+with open("census.cells", "w") as file:
+    file.write("!census test\n" + "\n".join("".join(row) for row in grid) + "\n")
+PATTERN
+
+"$mpirun" $flags -np 3 "$executable" 48 8 8 false false false --pattern=census.cells --pattern-offset=0,0 --census=1 > output.txt 2>&1 || { cat output.txt; exit 1; }
+cat mpi_census-8-48x48.csv
+# generation,objects,population,block,beehive,loaf,boat,tub,pond,ship,blinker,toad,beacon,glider,lwss,other
+python3 - <<'CHECK'
+import csv, sys
+rows = list(csv.DictReader(open("mpi_census-8-48x48.csv")))
+expected = {"objects": "5", "block": "1", "blinker": "1", "toad": "1", "beacon": "1", "lwss": "1", "other": "0"}
+if len(rows) != 9:
+    sys.exit("expected 9 censuses, got %d" % len(rows))
+for row in rows:
+    wrong = {name: row[name] for name, count in expected.items() if row[name] != count}
+    if wrong:
+        sys.exit("generation %s: %s" % (row["generation"], wrong))
+print("census constant over %d generations" % len(rows))
+CHECK
@@ -0,0 +1,45 @@
+#!/bin/bash
+# A server on stdin answers every job with one line on stdout and keeps running after jobs with a directory, an RLE file
+# without a header or an image that cannot be created. The glider of the last job keeps its 5 cells.
+# usage: server_test.sh <GameOfLife executable> [mpirun]
+set -e
+executable=$(realpath "$1")
+mpirun=${2:-mpirun}
+flags=""
+if "$mpirun" --version 2>&1 | grep -q "Open MPI"; then
+    flags="--oversubscribe"
+    if [ "$(id -u)" = 0 ]; then
+        flags="$flags --allow-run-as-root"
+    fi
+fi
+
+directory=$(mktemp -d)
+trap 'rm -rf "$directory"' EXIT
+cd "$directory"
+printf '#C no header\nbo$2bo$3o!\n' > headless.rle
+printf 'x = 3, y = 3\nbo$2bo$3o!\n' > glider.rle
+cat > jobs.txt <<JOBS
+size=50 generations=2
+size=50 pattern=$directory
+size=50 pattern=headless.rle
+size=50 generations=2 image=$directory/missing/result.pbm
+size=50 generations=4 pattern=glider.rle image=result.pbm
+quit
+JOBS
+
+"$mpirun" $flags -np 3 "$executable" 50 5 5 false false false --serve=stdin < jobs.txt > answers.txt 2> output.txt || { cat answers.txt output.txt; exit 1; }
+cat answers.txt
+python3 - <<'CHECK'
+import re, sys
+answers = open("answers.txt").read().splitlines()
+expected = [r"job 1 ok ", r"job 2 error cannot load the pattern .*: not a regular file$", r"job 3 error cannot load the pattern headless.rle: ",
+    r"job 4 error cannot create the image ", r"job 5 ok .*population=5 .*image=result.pbm$", r"bye$"]
+if len(answers) != len(expected):
+    sys.exit("expected %d lines on stdout, got %d" % (len(expected), len(answers)))
+for answer, pattern in zip(answers, expected):
+    if not re.match(pattern, answer):
+        sys.exit("unexpected answer: %s" % answer)
+if not open("result.pbm", "rb").read().startswith(b"P"):
+    sys.exit("result.pbm is no portable bitmap")
+print("one answer per job, the bad jobs are rejected")
+CHECK